@@ -36,27 +36,122 @@
 #include <getopt.h>
 #include <regex>
 #include <algorithm>
+#include <cmath>
+#include <random>
+#include <bitset>
+#include <unordered_map>
+#include <unordered_set>
+#include <sstream>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <stdarg.h>
+#include <map>
+#include <string_view>
+#include <memory>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <mutex>
+#include <deque>
+#include <condition_variable>
+#include <sys/wait.h>
+#include <sys/inotify.h>
+#include <poll.h>
 
-#define VECTORRESERVE 10
+//number of rule file lines that are read and parsed in parallel before results are merged
+#define PARSEBATCHSIZE 16384
+//number of lines a parser thread takes at once
+#define PARSECHUNKSIZE 64
+//number of parsed rules and of prepared requests the stages of --stream hold at most between each other
+#define STREAMQUEUEDEPTH 1024
+//number of requests the sender takes from the --stream pipeline at once
+#define STREAMBATCHSIZE 256
+//milliseconds without further writes to the rule file before --watch handles a change
+#define WATCHSETTLEMILLISECONDS 50
+//how many repetitions more than the minimum the native pcre generator produces at most for unbounded quantifiers (*,+,{n,})
+#define PCREUNBOUNDEDREPEAT 10
+//bump if the native pcre generator produces different strings for the same pattern and seed, invalidates cached payloads
+#define PCREGENERATORVERSION 1
+#define PCRECACHEMAGIC "IDSPCRC1"
+//with --variants the native pcre generator tries this many strings per wanted variant to find distinct ones
+#define PCREVARIANTATTEMPTS 4
+//bump if the parser produces different rules from the same rule file or the layout of snortRule or the rule cache changes, invalidates rule caches
+#define RULEPARSERVERSION 3
+#define RULECACHEMAGIC "IDSRULC1"
+//bytes of a cached rule with empty strings and no matches, a rule count the rest of the file cannot hold marks a broken cache
+#define RULECACHEMINRECORD 41
+//change if the rule index (--sids, --msg, --modifier) finds other lines or other fields
+#define RULEINDEXVERSION 1
+#define RULEINDEXMAGIC "IDSRIDX1"
+//bytes of an index entry with empty sid, rev and msg
+#define RULEINDEXMINRECORD 30
+//how many seconds worth of requests the rate limiter may send at once to make up for sleep granularity
+#define RATEBURSTSECONDS 0.005
+//default seconds between two throughput reports in soak mode
+#define SOAKREPORTSECONDS 60
+//seconds until a request of the raw backend is given up, same as the curl timeout
+#define RAWTIMEOUTSECONDS 3
+//server written into pcap files if no server is configured with -s
+#define PCAPDEFAULTHOST "http://10.0.0.1"
+//bytes of pcap records collected before they are written to the file
+#define PCAPBUFFERSIZE (1<<20)
+//latency histogram bucket i counts [2^i,2^(i+1)) microseconds, 32 buckets reach more than an hour
+#define LATENCYBUCKETS 32
+//bytes of captured responses collected before the writer thread writes them
+#define CAPTUREBUFFERSIZE (1<<20)
+//full capture buffers waiting for the writer thread, if there are more responses are dropped instead of slowing down sending
+#define CAPTUREQUEUEDEPTH 16
+//bytes of every response that are captured by default
+#define CAPTUREMAXDEFAULT 65536
+#define CAPTUREMAGIC "IDSRESP1"
+
+//part of the http request or response a content or pcre has to match, HTTP_NONE if the rule does not say
+enum httpModifier : uint8_t {HTTP_NONE, HTTP_METHOD, HTTP_URI, HTTP_RAW_URI, HTTP_STAT_MSG, HTTP_STAT_CODE, HTTP_HEADER, HTTP_RAW_HEADER,
+	HTTP_CLIENT_BODY, HTTP_COOKIE, HTTP_RAW_COOKIE, HTTP_MODIFIERCOUNT};
+//snort keyword of every httpModifier
+const char* httpModifierNames[HTTP_MODIFIERCOUNT]={"","http_method","http_uri","http_raw_uri","http_stat_msg","http_stat_code","http_header",
+	"http_raw_header","http_client_body","http_cookie","http_raw_cookie"};
+
+/**
+ * one content or pcre of a rule
+ */
+class ruleMatch {
+	public:
+		enum flag : uint8_t {PCRE=1, NEGATED=2, NOCASE=4, CONTAINSHEX=8};
+		//hex converted content, or pcre without slashes and modifiers
+		std::string pattern;
+		httpModifier modifier=HTTP_NONE;
+		uint8_t flags=0;
+
+		bool has(flag matchFlag) const{
+			return (flags&matchFlag)!=0;
+		}
+
+		void set(flag matchFlag, bool value){
+			if(value){
+				flags|=matchFlag;
+			}else{
+				flags&=~matchFlag;
+			}
+		}
+};
 
 class ruleBody{
     public:
 		std::string msg;
-		std::vector<bool> negatedContent;
-		std::vector<std::string> contentOriginal;
-		std::vector<bool> containsHex;
-		std::vector<bool> contentNocase;
-		std::vector<std::string> content;
-		std::vector<int> contentModifierHTTP;
-		//content modifier are encoded for faster processing:
-		//1:http_method
-		//2:http_uri
-		//3:http_raw_uri
-		//4:http_stat_msg
-		//5:http_stat_code
-		std::vector<std::string> pcre;
-		std::vector<bool> negatedPcre;
-		std::vector<bool> pcreNocase;
+		//all contents in rule order, followed by all pcres in rule order
+		std::vector<ruleMatch> matches;
 		std::string sid;
 		std::string rev;
 };
@@ -78,58 +173,159 @@ class snortRule {
     ruleBody body;
 };
 
+/**
+ * the HTTP request for one rule, built once by prepareRulePacket() and not changed afterwards.
+ * Senders only hand its fields to curl, so it can be sent any number of times and by any sender without building it again.
+ */
+class preparedRequest {
+	public:
+		enum methodType {GET, POST, CUSTOM};
+		methodType method=GET;
+		//only for CUSTOM, e.g. PUT
+		std::string customMethod;
+		//host and uri
+		std::string url;
+		//custom headers including the Rulesid header, curl only reads the list so all transfers can use it at the same time
+		std::unique_ptr<struct curl_slist, void(*)(struct curl_slist*)> header{NULL,curl_slist_free_all};
+		std::string cookies;
+		std::string clientBody;
+		bool hasClientBody=false;
+		std::string sid;
+		//payload variant of the rule, see --variants
+		unsigned long variant=0;
+		//bit (1<<httpModifier) is set for every modifier of a content or pcre that went into the request, for per modifier statistics
+		uint16_t modifierMask=0;
+		//only for the raw backend: the complete request as it goes on the wire
+		std::string raw;
+		//status of the response the rule expects (http_stat_code, http_stat_msg), sent by the built-in responder. 0 and empty for 200 OK
+		int statusCode=0;
+		std::string statusMessage;
+};
+
+/**
+ * everything that has to stay alive while the request for one rule is in flight
+ */
+class rulePacketTransfer {
+	public:
+		CURL *handle=NULL;
+		//curl does not copy POSTFIELDS or the header list, the prepared request has to outlive the transfer
+		const preparedRequest *request=NULL;
+		//only for response capture: the first bytes of the response and the length of the whole response
+		std::string response;
+		std::size_t responseLength=0;
+};
 
 
-std::size_t bodyStartPosition;
 bool printResponse=false;
 bool continueOnError=false;
 bool verbose=false;
+//generate pcre payloads with the exrex command instead of the native generator
+bool externalPcreGenerator=false;
+//seed of the native pcre generator, part of the payload cache key
+unsigned long pcreSeed=0;
+//number of distinct pcre payloads, and so requests, per rule
+unsigned long payloadVariants=1;
+//send requests with the raw socket backend instead of libcurl, requests are sent byte exact then
+bool rawBackend=false;
+//write requests as TCP sessions to a pcap file instead of sending them, byte exact like the raw backend
+bool pcapExport=false;
+//accept rules that look at the server response (http_stat_code, http_stat_msg, to_client), only the built-in responder can answer them
+bool responseRules=false;
 int packetCounter=1;
+//requests that got a response or failed, for throughput reports
+unsigned long finishedRequests=0;
+unsigned long failedRequests=0;
+
+//keywords parseRuleLine() looks for in a rule line before parsing it, found in one pass by ruleKeywordScanner
+enum ruleKeyword {KEYWORD_CONTENT, KEYWORD_PCRE, KEYWORD_FLOWBITS, KEYWORD_DISTANCE, KEYWORD_WITHIN, KEYWORD_OFFSET, KEYWORD_DEPTH,
+	KEYWORD_DCE, KEYWORD_THRESHOLD, KEYWORD_URILEN, KEYWORD_DETECTIONFILTER, KEYWORD_FROMSERVER, KEYWORD_TOCLIENT, KEYWORD_CONTENTSPACE,
+	KEYWORD_HTTP, RULEKEYWORDCOUNT};
+const char* ruleKeywordStrings[RULEKEYWORDCOUNT]={"content:","pcre:","flowbits:","distance:","within:","offset:","depth:","dce_","threshold:",
+	"urilen:","detectionfilter","from_server","to_client","content: ","http_"};
+//why parseRuleLine() did not use a line, REJECT_KEYWORD+k if ruleKeyword k is not supported
+enum rejectReason {REJECT_NONE, REJECT_COMMENT, REJECT_NOALERT, REJECT_NOCONTENT, REJECT_NOHTTPMODIFIER, REJECT_KEYWORD};
+
+/**
+ * state of parsing one rule line.
+ * Parse functions write their messages here instead of printing them, so lines can be parsed in parallel and messages are still printed in file order.
+ */
+class ruleParseContext {
+	public:
+		int linenumber=0;
+		//set if parsing this line hit an error that aborts the run
+		bool fatal=false;
+		//why the line is not used, a rejectReason
+		int rejection=REJECT_NONE;
+
+		/**
+		 * adds a printf formatted message for the given stream
+		 */
+		void print(FILE* stream, const char* format, ...){
+			va_list arguments;
+			va_list argumentsCopy;
+			char buffer[512];
+			va_start(arguments,format);
+			va_copy(argumentsCopy,arguments);
+			int length=vsnprintf(buffer,sizeof(buffer),format,arguments);
+			if(length>=(int)sizeof(buffer)){
+				std::string message(length,'\0');
+				vsnprintf(&message[0],length+1,format,argumentsCopy);
+				messages.push_back(std::make_pair(stream,message));
+			}else if(length>0){
+				messages.push_back(std::make_pair(stream,std::string(buffer,length)));
+			}
+			va_end(argumentsCopy);
+			va_end(arguments);
+		}
+
+		/**
+		 * prints all messages in the order they were written
+		 */
+		void flush(){
+			for(unsigned long i=0;i<messages.size();i++){
+				fputs(messages[i].second.c_str(),messages[i].first);
+			}
+			messages.clear();
+		}
+
+	private:
+		std::vector<std::pair<FILE*,std::string> > messages;
+};
 
 /**
-* writes error message to stderr
+* writes error message for stderr to the parse context
 */
-void parsingError(int line, std::string parsingPart){
-    fprintf(stderr,"Error on line %d, failed to parse %s. This does not seem to be a valid Snort rule. Aborting!\n",line, parsingPart.c_str());
+void parsingError(ruleParseContext* context, std::string parsingPart){
+    context->print(stderr,"Error on line %d, failed to parse %s. This does not seem to be a valid Snort rule. Aborting!\n",context->linenumber, parsingPart.c_str());
 }
 
 /**
- * counts single rule fields (-->content vectors size) and checks if numbers match
+ * checks if the parsed rule makes sense
  * if this check fails something went terribly wrong while parsing!!!
  */
-void plausabilityCheck(snortRule* rule, int *linenumber){
+void plausabilityCheck(snortRule* rule, ruleParseContext* context){
 	//plausability checks:
-	if(rule->body.content.size()==0&&rule->body.pcre.size()==0){
-		fprintf(stderr,"SnortRuleParser: There was an error in rule parsing: After parsing, rule with sid %s does not contain any content or pcre to check for. This should not have happened. Aborting!\n",rule->body.sid.c_str());
+	if(rule->body.matches.empty()){
+		context->print(stderr,"SnortRuleParser: There was an error in rule parsing: After parsing, rule with sid %s does not contain any content or pcre to check for. This should not have happened. Aborting!\n",rule->body.sid.c_str());
 		if(continueOnError==false){
-			exit(1);
-		}
-	}
-	    if(rule->body.content.size()!=rule->body.contentOriginal.size()
-	    ||rule->body.content.size()!=rule->body.negatedContent.size()
-	    ||rule->body.content.size()!=rule->body.containsHex.size()
-		//the pcre http modifiers are written into the contentModifierHTTP
-	    ||(rule->body.content.size()+rule->body.pcre.size())!=rule->body.contentModifierHTTP.size()
-	    ||rule->body.content.size()!=rule->body.contentNocase.size()
-	    ||rule->body.negatedPcre.size()!=rule->body.pcre.size()
-		||rule->body.pcreNocase.size()!=rule->body.pcre.size()){
-	        fprintf(stderr,"\n\nThere was an Error in rule parsing at line %d, parsed content vectors do not match in size. This should not have happened. Aborting!\n",*linenumber);
-	        fprintf(stderr,"content: %lu, contentOriginal: %lu, pcre: %lu, negatedPcre: %lu, pcreNocase: %lu, negatedContent: %lu, containsHex: %lu, ContentModifierHttp: %lu\n",rule->body.content.size(),rule->body.contentOriginal.size(),rule->body.pcre.size(),rule->body.negatedPcre.size(),rule->body.pcreNocase.size(),rule->body.negatedContent.size(),rule->body.containsHex.size(),rule->body.contentModifierHTTP.size());
-	        if(continueOnError==false){
-	        	exit(1);
-	        }
-	    }
+			context->fatal=true;
+			return;
+		}
+	}
 }
 
 /**
 *prints snortRule struct to stdout
 */
 void printSnortRule(snortRule* rule){
-	std::string modifierHttp;
-
 	//is already done in main(), so basically superfluous. But for some cases (mass checks) I might comment it there, so a "backup" here.
-	int dummyInt=-1;
-	plausabilityCheck(rule, &dummyInt);
+	ruleParseContext context;
+	context.linenumber=-1;
+	plausabilityCheck(rule, &context);
+	context.flush();
+	if(context.fatal){
+		exit(1);
+	}
 
 	fprintf(stdout,"Action:\t\t\t\t%s\n",rule->header.action.c_str());
 	    fprintf(stdout,"Protocol:\t\t\t%s\n",rule->header.protocol.c_str());
@@ -145,66 +341,37 @@ void printSnortRule(snortRule* rule){
 
     fprintf(stdout,"Message:\t\t\t%s\n",rule->body.msg.c_str());
 
-    //loop through content related vectors
-    for(unsigned long i=0;i<rule->body.content.size();i++){
-        if(rule->body.negatedContent.at(i)==true){
+    //contents come first, so they are printed before pcres
+    for(unsigned long i=0;i<rule->body.matches.size();i++){
+    	const ruleMatch* match=&rule->body.matches[i];
+        if(match->has(ruleMatch::NEGATED)){
             fprintf(stdout,"NOT ");
         }
-        //fprintf(stdout,"ContentOriginal:\t%s\n",rule->body.contentOriginal[i].c_str());
-        if(rule->body.containsHex.at(i)==true){
-            fprintf(stdout,"Content (hex converted):\t%s\n",rule->body.content.at(i).c_str());
-        }else{
-            fprintf(stdout,"Content:\t\t\t\"%s\"\n",rule->body.content.at(i).c_str());
+        if(match->modifier>=HTTP_MODIFIERCOUNT){
+        	fprintf(stderr,"IpfixIds: Wrong internal content modifier HTTP encoding. Aborting!\n");
+        	exit(0);
         }
-        switch(rule->body.contentModifierHTTP.at(i)){
-                	case 0: modifierHttp=""; break;
-                	case 1: modifierHttp="http_method"; break;
-                	case 2: modifierHttp="http_uri"; break;
-                	case 3: modifierHttp="http_raw_uri"; break;
-                	case 4: modifierHttp="http_stat_msg"; break;
-                	case 5: modifierHttp="http_stat_code"; break;
-                	case 6: modifierHttp="http_header"; break;
-                	case 7: modifierHttp="http_raw_header"; break;
-                	case 8: modifierHttp="http_client_body"; break;
-                	case 9: modifierHttp="http_cookie"; break;
-                	case 10: modifierHttp="http_raw_cookie"; break;
-                	default: fprintf(stderr,"IpfixIds: Wrong internal content modifier HTTP encoding. Aborting!\n"); exit(0);
-                }
-        fprintf(stdout,"ContentModifierHttp:\t\t%s\n",modifierHttp.c_str());
-        if(rule->body.contentNocase[i]==true){
-            fprintf(stdout,"Nocase:\t\t\t\ttrue\n");
+        if(!match->has(ruleMatch::PCRE)){
+			if(match->has(ruleMatch::CONTAINSHEX)){
+				fprintf(stdout,"Content (hex converted):\t%s\n",match->pattern.c_str());
+			}else{
+				fprintf(stdout,"Content:\t\t\t\"%s\"\n",match->pattern.c_str());
+			}
+			fprintf(stdout,"ContentModifierHttp:\t\t%s\n",httpModifierNames[match->modifier]);
+			if(match->has(ruleMatch::NOCASE)){
+				fprintf(stdout,"Nocase:\t\t\t\ttrue\n");
+			}else{
+				fprintf(stdout,"Nocase:\t\t\t\tfalse\n");
+			}
         }else{
-            fprintf(stdout,"Nocase:\t\t\t\tfalse\n");
-        }
-    }
-
-    //loop through pcre related vectors
-    for(unsigned long j=0;j<rule->body.pcre.size();j++){
-        if(rule->body.negatedPcre.at(j)==true){
-            fprintf(stdout,"NOT ");
+			fprintf(stdout,"pcre:\t\t\t\t%s\n",match->pattern.c_str());
+			fprintf(stdout,"pcreModifierHttp:\t\t%s\n",httpModifierNames[match->modifier]);
+			if(match->has(ruleMatch::NOCASE)){
+				fprintf(stdout,"NocasePcre:\t\t\ttrue\n");
+			}else{
+				fprintf(stdout,"NocasePcre:\t\t\tfalse\n");
+			}
         }
-        fprintf(stdout,"pcre:\t\t\t\t%s\n",rule->body.pcre.at(j).c_str());
-        switch(rule->body.contentModifierHTTP.at(j+(rule->body.content.size()))){
-                        	case 0: modifierHttp=""; break;
-                        	case 1: modifierHttp="http_method"; break;
-                        	case 2: modifierHttp="http_uri"; break;
-                        	case 3: modifierHttp="http_raw_uri"; break;
-                        	case 4: modifierHttp="http_stat_msg"; break;
-                        	case 5: modifierHttp="http_stat_code"; break;
-                        	case 6: modifierHttp="http_header"; break;
-                        	case 7: modifierHttp="http_raw_header"; break;
-                        	case 8: modifierHttp="http_client_body"; break;
-                        	case 9: modifierHttp="http_cookie"; break;
-                        	case 10: modifierHttp="http_raw_cookie"; break;
-                        	default: fprintf(stderr,"IpfixIds: Wrong internal pcre content modifier HTTP encoding. Aborting!\n"); exit(0);
-                        }
-		fprintf(stdout,"pcreModifierHttp:\t\t%s\n",modifierHttp.c_str());
-		if(rule->body.pcreNocase[j]==true){
-					fprintf(stdout,"NocasePcre:\t\t\ttrue\n");
-				}else{
-					fprintf(stdout,"NocasePcre:\t\t\tfalse\n");
-				}
-
     }
 
     fprintf(stdout,"sid:\t\t\t\t%s\n",rule->body.sid.c_str());
@@ -213,92 +380,115 @@ void printSnortRule(snortRule* rule){
 }
 
 /**
-* returns a string of x Xs
-*/
-std::string xtimesx(int x){
-    std::string returnString="";
-    for(int i=0;i<x;i++){
-        returnString=returnString+"X";
-    }
-    return(returnString);
-}
+ * one option of a rule body, e.g. content:!"abc". keyword, value and modifiers point into the rule line, they are only valid as long as the line is.
+ */
+class ruleOption {
+	public:
+		std::string_view keyword;
+		//raw text after the colon, for content, uricontent and pcre without the negation sign
+		std::string_view value;
+		bool negated=false;
+		//only for content and uricontent: keywords of all following options up to the next content or uricontent, e.g. nocase, http_uri
+		std::vector<std::string_view> modifiers;
+};
 
 /**
-*   replaces escaped chars in given text
-*   according to the snort manual only 3 chars have to be escaped inside a content rule: ;,",\
-*/
-std::string replaceEscapedChars(std::string* text){
-    std::string returnString;
-    std::size_t startPosition;
-
-    returnString=*text;
-
-    //first replace escaped backslash(\\)
-    startPosition=returnString.find("\\");
-    while(startPosition!=std::string::npos){
-        returnString.replace(startPosition,2,"XX");
-        startPosition=returnString.find("\\");
-    }
-
-    //replace escaped quotes(\")
-    startPosition=returnString.find("\\\"");
-    while(startPosition!=std::string::npos){
-        returnString.replace(startPosition,2,"XX");
-        startPosition=returnString.find("\\\"");
-    }
-
-    //replace escaped semicolon(\;)
-    startPosition=returnString.find("\\;");
-    while(startPosition!=std::string::npos){
-        returnString.replace(startPosition,2,"XX");
-        startPosition=returnString.find("\\;");
-    }
-
-    return returnString;
+ * splits the body of the given rule line into its options in a single pass.
+ * Semicolons and parentheses inside quotes or escaped by a backslash do not end an option.
+ * Returns false if the line has no rule body.
+ */
+bool tokenizeRuleBody(std::string_view line, std::vector<ruleOption>* options){
+	std::size_t bodyStart=line.find('(');
+	std::size_t optionStart;
+	bool inQuotes=false;
+	long lastContent=-1;
+	options->clear();
+	if(bodyStart==std::string::npos){
+		return false;
+	}
+	optionStart=bodyStart+1;
+	for(std::size_t i=optionStart;i<line.size();i++){
+		char c=line[i];
+		if(c=='\\'){
+			//escaped char never ends anything
+			i++;
+			continue;
+		}
+		if(c=='"'){
+			inQuotes=!inQuotes;
+			continue;
+		}
+		if(inQuotes||(c!=';'&&c!=')')){
+			continue;
+		}
+		//option ends here, skip leading whitespace
+		while(optionStart<i&&isspace(line[optionStart])){
+			optionStart++;
+		}
+		if(optionStart<i){
+			ruleOption option;
+			std::size_t colon=line.find(':',optionStart);
+			if(colon==std::string::npos||colon>i){
+				colon=i;
+			}else{
+				option.value=line.substr(colon+1,i-colon-1);
+			}
+			std::size_t keywordEnd=colon;
+			while(keywordEnd>optionStart&&isspace(line[keywordEnd-1])){
+				keywordEnd--;
+			}
+			option.keyword=line.substr(optionStart,keywordEnd-optionStart);
+			if(option.keyword=="content"||option.keyword=="uricontent"||option.keyword=="pcre"){
+				if(!option.value.empty()&&option.value[0]=='!'){
+					option.negated=true;
+					option.value.remove_prefix(1);
+				}
+			}
+			if(option.keyword=="content"||option.keyword=="uricontent"){
+				lastContent=options->size();
+			}else if(lastContent>=0){
+				options->at(lastContent).modifiers.push_back(option.keyword);
+			}
+			options->push_back(option);
+		}
+		optionStart=i+1;
+		if(c==')'){
+			break;
+		}
+	}
+	return true;
 }
 
 /**
-* This function replaces everything in quotes of the given string with Xs, this includes also escaped characters
-* this can be used in keyword search to avoid finding keywords in escaped strings
-*/
-std::string replaceQuotedText(std::string* quotedText){
-    std::size_t startPosition;
-    std::size_t endPosition;
-    std::string quotedTextReplaced;
-
-    //replace all escaped chars
-    quotedTextReplaced=replaceEscapedChars(quotedText);
-
-    //replace everything else that is quoted
-    startPosition=std::string::npos;
-    startPosition=quotedTextReplaced.find("\"",0);
-    endPosition=quotedTextReplaced.find("\"",startPosition+1);
-    while(startPosition!=std::string::npos&&endPosition!=std::string::npos){
-        quotedTextReplaced.replace(startPosition,endPosition-startPosition+1,xtimesx(endPosition-startPosition+1));
-        startPosition=quotedTextReplaced.find("\"",0);
-        endPosition=quotedTextReplaced.find("\"",startPosition+1);
-    }
-
-    return quotedTextReplaced;
+ * returns the first option with the given keyword starting at index start, NULL if there is none
+ */
+ruleOption* findRuleOption(std::vector<ruleOption>* options, std::string_view keyword, unsigned long start=0){
+	for(unsigned long i=start;i<options->size();i++){
+		if(options->at(i).keyword==keyword){
+			return &options->at(i);
+		}
+	}
+	return NULL;
 }
 
 /**
-*parses the rule msg from given line and writes it to given snortRule class
+*parses the rule msg from given rule options and writes it to given snortRule class
 */
-void parseMsg(std::string* line, int* linecounter, snortRule* tempRule){
-    std::size_t startPosition=line->find("msg:",0)+4;
-    std::size_t endPosition=line->find(";",startPosition);
-    if(startPosition==(std::string::npos+4)||endPosition==std::string::npos){
-        parsingError(*linecounter,"msg");
-        exit(1);
+void parseMsg(std::vector<ruleOption>* options, ruleParseContext* context, snortRule* tempRule){
+    ruleOption* msg=findRuleOption(options,"msg");
+    if(msg==NULL||msg->value.size()<2){
+        parsingError(context,"msg");
+        context->fatal=true;
+        return;
     }
-    tempRule->body.msg=line->substr(startPosition+1,(endPosition-startPosition)-2);
+    //cut away quotes
+    tempRule->body.msg=msg->value.substr(1,msg->value.size()-2);
 }
 
 /**
 *parses the rule header from given line and writes it to given snortRule class
 */
-void parseHeader(std::string* line, int* linecounter, snortRule* tempRule){
+void parseHeader(std::string_view line, ruleParseContext* context, snortRule* tempRule){
 		std::string headerString;
 	    std::string from;
 	    std::string fromPort;
@@ -306,11 +496,11 @@ void parseHeader(std::string* line, int* linecounter, snortRule* tempRule){
 	    std::size_t start;
 	    std::size_t end;
 
-	    start=line->find("(");
+	    start=line.find("(");
 	    if(start==std::string::npos){
-	        parsingError(*linecounter, "header");
+	        parsingError(context, "header");
 	    }
-	    headerString=line->substr(0,start);
+	    headerString=line.substr(0,start);
 	    end=headerString.find(" ");
 	    tempRule->header.action=headerString.substr(0,end);
 	    headerString.erase(0,end+1);
@@ -324,7 +514,7 @@ void parseHeader(std::string* line, int* linecounter, snortRule* tempRule){
 	    if(end==std::string::npos){
 	    	end=headerString.find("->");
 	    	if(end==std::string::npos){
-	    		parsingError(*linecounter,"header direction sign");
+	    		parsingError(context,"header direction sign");
 	    	}
 	    	tempRule->header.bidirectional=false;
 	    }else{
@@ -338,23 +528,24 @@ void parseHeader(std::string* line, int* linecounter, snortRule* tempRule){
 
 		end=from.find(" ");
 		if(end==std::string::npos){
-			parsingError(*linecounter,"no space between from address and port");
+			parsingError(context,"no space between from address and port");
 		}
 		tempRule->header.from=from.substr(0,end);
 		from.erase(0,end+1);
 		fromPort=from.substr(0,from.size());
 		//this only catches if the default variable is used, but thats life...
-		if(fromPort.find("$HTTP_PORTS")!=std::string::npos){
-			fprintf(stderr,"Error: Rule looks for packet coming from server ports ($HTTP_PORTS variable). Can not control server responses, please remove this rule. Line: %d\n",*linecounter);
+		if(!responseRules&&fromPort.find("$HTTP_PORTS")!=std::string::npos){
+			context->print(stderr,"Error: Rule looks for packet coming from server ports ($HTTP_PORTS variable). Can not control server responses, please remove this rule or use the built-in responder. Line: %d\n",context->linenumber);
         	if(continueOnError==false){
-        		exit(1);
+        		context->fatal=true;
+        		return;
         	}
 		}
 		tempRule->header.fromPort=fromPort;
 
 		end=to.find(" ");
 		if(end==std::string::npos){
-			parsingError(*linecounter,"no space between to address and port");
+			parsingError(context,"no space between to address and port");
 		}
 		tempRule->header.to=to.substr(0,end);
 		to.erase(0,end+1);
@@ -362,68 +553,49 @@ void parseHeader(std::string* line, int* linecounter, snortRule* tempRule){
 }
 
 /**
-* parses rule content (also multiple contents) from given line and writes it to given tempRule class in the corresponding vector of contents,
+* parses rule content (also multiple contents) from given rule options and writes it to given tempRule class in the corresponding vector of contents,
 * it also converts hex characters to ascii characters, if possible, if not it omits them in the output content
 */
-void parseContent(std::string* line, int* linecounter, snortRule* tempRule){
-    std::size_t startPosition;
-    std::size_t endPosition;
+void parseContent(std::vector<ruleOption>* options, ruleParseContext* context, snortRule* tempRule){
     std::size_t hexStartPosition;
     std::size_t hexEndPosition=0;
     std::string hexContent;
     std::string contentOrig;
     std::string contentHexFree;
-    std::string tempContent;
     std::string byte;
-    //we have to copy the line because we are messing around with it
-    std::string lineCopy=*line;
-    //this string is the same as line copy, only quotet text is replaces by X. length is the same!
-    std::string lineCopySearch=replaceQuotedText(&lineCopy);
     char tempChar;
     std::size_t tempPosition;
-    int contentCounter=0;
-
-    //on the first check there should definitively be at least one content
-    startPosition=lineCopySearch.find("content:",bodyStartPosition)+8;
-    endPosition=lineCopySearch.find(";",startPosition);
-    if(startPosition==(std::string::npos+8)||endPosition==std::string::npos){
-        parsingError(*linecounter,"content");
-        exit(1);
-    }
+    bool foundContent=false;
 
-    //loop to detect multiple content keywords, same check as above is repeated, will be true first time for sure, but we dont want to call parsingError the other times
-    while(startPosition!=(std::string::npos+8)&&endPosition!=std::string::npos){
+    for(unsigned long j=0;j<options->size();j++){
+    	ruleOption* option=&options->at(j);
+    	//we dont have to check for uricontent here because we can take care the same way we do for content. we have to take special care in parseContentModifier
+    	if(option->keyword!="content"&&option->keyword!="uricontent"){
+    		continue;
+    	}
+    	foundContent=true;
         contentHexFree="";
+        ruleMatch match;
         //check if content is negated BWARE: than also modifiers are negated!!!
-        if(lineCopy.substr(startPosition,1)=="!"){
-            tempRule->body.negatedContent.push_back(true);
-            //cut away negation sign
-            lineCopy.erase(startPosition,1);
-            lineCopySearch.erase(startPosition,1);
-            //because we erase one character, the endPosition moves back on char
-            endPosition--;
-        }else{
-            tempRule->body.negatedContent.push_back(false);
-        }
+        match.set(ruleMatch::NEGATED,option->negated);
 
-        //we dont have to check for uricontent here because we can take care the same way we do for content. we have to take special care in parseContentModifier
-
-        contentOrig=lineCopy.substr(startPosition,(endPosition-startPosition));
-        //cut away quotes
-        contentOrig=contentOrig.substr(1,(contentOrig.size()-2));
+        //cut away quotes, content:; has none
+        if(option->value.size()<2){
+            parsingError(context,"content (empty value)");
+            context->fatal=true;
+            return;
+        }
+        contentOrig=option->value.substr(1,(option->value.size()-2));
 
-        //for debug and functionality check purposes write original content
-        tempRule->body.contentOriginal.push_back(contentOrig);
         //check if it contains hex
         hexStartPosition=contentOrig.find("|");
 
         //is checked again below, but necessery here too
         if(hexStartPosition!=std::string::npos||contentOrig.find("|",hexStartPosition+1)!=std::string::npos){
-            tempRule->body.containsHex.push_back(1);
+            match.set(ruleMatch::CONTAINSHEX,true);
             //if it contains hex than add hexfree content before hex content to contentHexFree
             contentHexFree=contentHexFree+contentOrig.substr(0,hexStartPosition);
         }else{
-            tempRule->body.containsHex.push_back(0);
             //if it does not contain hex at all add it now to hex free content
             contentHexFree=contentHexFree+contentOrig;
         }
@@ -431,9 +603,10 @@ void parseContent(std::string* line, int* linecounter, snortRule* tempRule){
         while(hexStartPosition!=std::string::npos){
             hexEndPosition=contentOrig.find("|",hexStartPosition+1);
             if(hexEndPosition==std::string::npos){
-                fprintf(stdout,"Debug: content no hex=\t\t%s\nalready converted content:\t%s\n",contentOrig.c_str(),contentHexFree.c_str());
-                parsingError(*linecounter,"hex content (no termination sign)");
-                exit(1);
+                context->print(stdout,"Debug: content no hex=\t\t%s\nalready converted content:\t%s\n",contentOrig.c_str(),contentHexFree.c_str());
+                parsingError(context,"hex content (no termination sign)");
+                context->fatal=true;
+                return;
             }
             //copying hex string and cutting off first pipe sign
             hexContent=contentOrig.substr(hexStartPosition+1,(hexEndPosition-hexStartPosition)-1);
@@ -459,7 +632,7 @@ void parseContent(std::string* line, int* linecounter, snortRule* tempRule){
 					if(isprint(tempChar)){
 						asciiString.push_back(tempChar);
 					}else{//warn if not printable
-						fprintf(stderr,"WARNING: non-printable hex chars (except 0d and 0a) and hex > 7F are not supported and thus omitted. Hex: %s, rule sid: %s, line:%d\n",byte.c_str(), tempRule->body.sid.c_str(), *linecounter);
+						context->print(stderr,"WARNING: non-printable hex chars (except 0d and 0a) and hex > 7F are not supported and thus omitted. Hex: %s, rule sid: %s, line:%d\n",byte.c_str(), tempRule->body.sid.c_str(), context->linenumber);
 					}
                 }
             }
@@ -476,137 +649,74 @@ void parseContent(std::string* line, int* linecounter, snortRule* tempRule){
             }
         }//while hex loop
         //add the summed up content to the rule class
-        tempRule->body.content.push_back(contentHexFree);
-        //erase content keyword, so that loop can find next content keyword or break
-        lineCopy.erase(startPosition-8,8);
-        //to keep same length do the same for search string
-        lineCopySearch.erase(startPosition-8,8);
-        startPosition=lineCopySearch.find("content:",bodyStartPosition)+8;
-        endPosition=lineCopySearch.find(";",startPosition);
-        contentCounter++;
-    }//while content loop
+        match.pattern=contentHexFree;
+        tempRule->body.matches.push_back(match);
+    }//content loop
+
+    //there should definitively be at least one content
+    if(!foundContent){
+        parsingError(context,"content");
+        context->fatal=true;
+        return;
+    }
 }
 
 /**
-* parses content modifiers from given line and writes it to given tempRule class in the corresponding vector
+* parses content modifiers from given rule options and writes it to given tempRule class in the corresponding vector
 * Only nocase and http_* content modifier are supported. rawbytes, depth, offset, distance, within, fast_pattern are ignored by the parser.
 */
-void parseContentModifier(std::string* line, int* linecounter, snortRule* tempRule){
-    bool uricontent=false;
-    std::size_t startPosition;
-    std::size_t endPosition;
-    std::size_t contentEndPosition;
-    std::size_t httpModifierStartPosition;
-    std::size_t httpModifierEndPosition;
-    std::string temp;
-    std::string allModifiers;
-    //we have to copy the line because we are messing around with it
-    std::string lineCopy=*line;
-    //this string is the same as lineCopy, only quoted text is replaces by X. length is the same. this way, searches dont trigger falsely on content found in quotes
-    std::string lineCopySearch=replaceQuotedText(&lineCopy);
-
-    //on the first check there should definitively be at least one content
-    startPosition=lineCopySearch.find("content:",bodyStartPosition)+8;
-    endPosition=lineCopySearch.find("content:",startPosition);
-    //for last content in rule the end is marked by the closing bracket of the rule body
-    if(endPosition==std::string::npos){
-        //do we have a +1 error here because of semicolon AND parentheses? No, because rule requires sid and rev keywords, and they are placed after modifiers
-        endPosition=(lineCopySearch.find(";)",startPosition));
-    }
+void parseContentModifier(std::vector<ruleOption>* options, ruleParseContext* context, snortRule* tempRule){
+    std::string_view temp;
+    //parseContent added one match per content option, in the same order
+    unsigned long contentIndex=0;
 
-    if(startPosition==(std::string::npos+8)||endPosition==std::string::npos){
-        parsingError(*linecounter,"content (modifier)");
-        exit(1);
-    }
+    for(unsigned long j=0;j<options->size();j++){
+    	ruleOption* option=&options->at(j);
+    	if(option->keyword!="content"&&option->keyword!="uricontent"){
+    		continue;
+    	}
+    	std::vector<std::string_view>* allModifiers=&option->modifiers;
+    	ruleMatch* match=&tempRule->body.matches.at(contentIndex++);
 
-    //loop to detect multiple content keywords, same check as above is repeated, will be true first time for sure, but we dont want to call parsingError the other times
-    while(startPosition!=(std::string::npos+8)&&endPosition!=std::string::npos){
-        temp=lineCopy.substr(startPosition,endPosition-startPosition);
-        allModifiers=replaceEscapedChars(&temp);
-        contentEndPosition=allModifiers.find(";");
-        if(startPosition==(std::string::npos+8)||endPosition==std::string::npos){
-            parsingError(*linecounter,"content (modifier), content string end position");
-            exit(1);
-        }
+        //see if it contains the nocase modifier
+        match->set(ruleMatch::NOCASE,std::find(allModifiers->begin(),allModifiers->end(),"nocase")!=allModifiers->end());
 
         //check if its the uricontent keyword:
-        if(lineCopy.substr(startPosition-11,3)=="uri"){
-        	uricontent=true;
+        if(option->keyword=="uricontent"){
+        	match->modifier=HTTP_URI;
+        	continue;
         }
-
-        //erase content keyword and content pattern
-        allModifiers.erase(0,contentEndPosition+1);
-
-        //see if it contains the nocase modifier
-        if(allModifiers.find("nocase;")==std::string::npos){
-            tempRule->body.contentNocase.push_back(false);
-        }else{
-            tempRule->body.contentNocase.push_back(true);
+        //find http content modifier:
+        temp="";
+        for(unsigned long k=0;k<allModifiers->size();k++){
+        	if(allModifiers->at(k).compare(0,5,"http_")==0){
+        		temp=allModifiers->at(k);
+        		break;
+        	}
         }
-
-
-        if(uricontent){
-        	tempRule->body.contentModifierHTTP.push_back(2);
-        }else{
-        	//find http content modifier:
-			httpModifierStartPosition=allModifiers.find("http_");
-			if(httpModifierStartPosition==std::string::npos){
-				tempRule->body.contentModifierHTTP.push_back(0);
-			}else{
-				httpModifierEndPosition=allModifiers.find(";",httpModifierStartPosition);
-				if(httpModifierEndPosition==std::string::npos){
-					parsingError(*linecounter,"content (modifier), content httpModifier end position");
-				}
-				temp=allModifiers.substr(httpModifierStartPosition,(httpModifierEndPosition-httpModifierStartPosition));
-				if(temp=="http_method"){
-					tempRule->body.contentModifierHTTP.push_back(1);
-				}else if(temp=="http_uri"){
-					tempRule->body.contentModifierHTTP.push_back(2);
-					//replace whitespaces in content patterns for http uris
-					//printf("uri detected, replacing:\n");
-					//temp=tempRule->body.content[tempRule->body.contentModifierHTTP.size()-1];
-					//printf("uri detected, replacing:\n");
-					for(int i = 0; i < tempRule->body.content.at(tempRule->body.contentModifierHTTP.size()-1).length(); i++)
-					{
-						if(tempRule->body.content.at(tempRule->body.contentModifierHTTP.size()-1).at(i)== ' '){
-							tempRule->body.content.at(tempRule->body.contentModifierHTTP.size()-1).at(i) = '+';
-						}
-					}
-					//tempRule->body.content.at(tempRule->body.contentModifierHTTP.size()-1)=temp;
-				}else if(temp=="http_raw_uri"){
-						tempRule->body.contentModifierHTTP.push_back(3);
-				}else if(temp=="http_stat_msg"){
-						//fprintf(stderr,"SnortRuleparser: content modifier http_stat_msg not supported in this version\n"); //just uncomment lines to support it
-						tempRule->body.contentModifierHTTP.push_back(4);
-				}else if(temp=="http_stat_code"){
-						tempRule->body.contentModifierHTTP.push_back(5);
-				}else if(temp=="http_header"){//BEWARE: this is not supported in Vermont because no IPFIX IE for http header exists
-						tempRule->body.contentModifierHTTP.push_back(6);
-				}else if(temp=="http_raw_header"){//BEWARE: this is not supported in Vermont because no IPFIX IE for http header exists
-						tempRule->body.contentModifierHTTP.push_back(7);
-				}else if(temp=="http_client_body"){//BEWARE: this is not supported in Vermont because no IPFIX IE for http header exists
-						tempRule->body.contentModifierHTTP.push_back(8);
-				}else if(temp=="http_cookie"){//BEWARE: this is not supported in Vermont because no IPFIX IE for http header exists
-						tempRule->body.contentModifierHTTP.push_back(9);
-				}else if(temp=="http_raw_cookie"){//BEWARE: this is not supported in Vermont because no IPFIX IE for http header exists
-						tempRule->body.contentModifierHTTP.push_back(10);
-				}else{
-					parsingError(*linecounter,"unrecognized content modifier");
-				}
-		}
-	}//if uricontent
-        //erase content keyword and content string, so that next content can be found
-        lineCopy.erase(startPosition-8,+8);
-        lineCopySearch.erase(startPosition-8,+8);
-
-        startPosition=lineCopySearch.find("content:",bodyStartPosition)+8;
-        endPosition=lineCopySearch.find("content:",startPosition);
-        //for last content in rule, the end is marked by the closing bracket of the rule body
-        if(endPosition==std::string::npos){
-            endPosition=(lineCopy.find(";)",startPosition))+1;
+        if(temp==""){
+        	continue;
+        }
+        for(int modifier=HTTP_METHOD;modifier<HTTP_MODIFIERCOUNT;modifier++){
+        	if(temp==httpModifierNames[modifier]){
+        		match->modifier=(httpModifier)modifier;
+        		break;
+        	}
         }
-    }//while
+        if(match->modifier==HTTP_NONE){
+        	parsingError(context,"unrecognized content modifier");
+        	if(continueOnError==false){
+        		context->fatal=true;
+        		return;
+        	}
+        }else if(match->modifier==HTTP_URI){
+        	//replace whitespaces in content patterns for http uris
+        	std::replace(match->pattern.begin(),match->pattern.end(),' ','+');
+        }
+        //BEWARE: http_header, http_raw_header, http_client_body, http_cookie and http_raw_cookie are not supported in Vermont because no IPFIX IE for them exists
+    }//content loop
 }
+
 /**
  * check given uri for disallowed and unwise characters see rfc-2396
  * print warning if true
@@ -622,49 +732,69 @@ void checkUri(std::string uri, std::string sid){
 	    fprintf(stderr,"WARNING: The HTTP uri used for this rule may contain unwise characters. sid: %s\n",sid.c_str());
 	}
 }
+
+/**
+ * http modifier of a snort specific pcre modifier letter, HTTP_NONE if it is not one
+ */
+httpModifier pcreModifier(char letter){
+	switch(letter){
+	case 'P'://client body
+		return HTTP_CLIENT_BODY;
+	case 'H'://http header 6
+		return HTTP_HEADER;
+	case 'D'://raw_header 7
+		return HTTP_RAW_HEADER;
+	case 'C'://cookie 9
+		return HTTP_COOKIE;
+	case 'K'://raw cookie 19
+		return HTTP_RAW_COOKIE;
+	case 'U'://uri
+		//TODO: it would make sense to check already here for unescaped unsupported or unwise chars, on the other hand snort does accept most of them anyway
+		return HTTP_URI;
+	case 'I'://raw uri
+		//checkUriPCRE(pcreString);
+		return HTTP_RAW_URI;
+	case 'M'://method
+		return HTTP_METHOD;
+	case 'S'://response code
+		return HTTP_STAT_CODE;
+	case 'Y'://response message
+		return HTTP_STAT_MSG;
+	default:
+		return HTTP_NONE;
+	}
+}
+
 /**
-* parses pcre patterns in given line and writes it to given tempRule class in the corresponding vectors
+* parses pcre patterns in given rule options and writes it to given tempRule class in the corresponding vectors
 */
-void parsePcre(std::string* line, int* linecounter, snortRule* tempRule){
-    std::size_t startPosition;
+void parsePcre(std::vector<ruleOption>* options, ruleParseContext* context, snortRule* tempRule){
     std::size_t endPosition;
     std::size_t iPosition;
-    //we have to copy the line because we are messing around with it
-    std::string lineCopy=*line;
-    //this string is the same as line copy, only quoted text is replaces by X. length is the same!
-    std::string lineCopySearch=replaceQuotedText(&lineCopy);
     std::string pcreModifierString;
-    std::string pcreString;
     std::string temp;
+    bool foundPcre=false;
 
-    //on the first check there should definitively be at least one pcre
-    startPosition=lineCopySearch.find("pcre:",bodyStartPosition)+5;
-    endPosition=lineCopySearch.find(";",startPosition);
-    //if not throw an error
-    if(startPosition==(std::string::npos+5)||endPosition==std::string::npos){
-    	parsingError(*linecounter,"pcre");
-        exit(1);
-    }
-
-    //loop to detect multiple pcre keywords, same check as above is repeated, will be true first time for sure, but we dont want to call parsingError the other times
-    while(startPosition!=(std::string::npos+5)&&endPosition!=std::string::npos){
-        if(lineCopy.substr(startPosition,1)=="!"){
-            tempRule->body.negatedPcre.push_back(true);
-            //erase negation sign
-            lineCopy.erase(startPosition,1);
-            lineCopySearch.erase(startPosition,1);
-            //adjust endPosition
-            endPosition--;
-        }else{
-            tempRule->body.negatedPcre.push_back(false);
+    for(unsigned long j=0;j<options->size();j++){
+    	ruleOption* option=&options->at(j);
+    	if(option->keyword!="pcre"){
+    		continue;
+    	}
+    	foundPcre=true;
+        ruleMatch match;
+        match.set(ruleMatch::PCRE,true);
+        match.set(ruleMatch::NEGATED,option->negated);
+        //copying pcre string (+snort specific modifiers) and cutting off quotes, pcre:; has none
+        if(option->value.size()<2){
+            parsingError(context,"pcre (empty value)");
+            context->fatal=true;
+            return;
         }
-        //copying pcre string (+snort specific modifiers) and cutting off quotes
-        temp=lineCopy.substr(startPosition+1,endPosition-startPosition-2);
+        temp=option->value.substr(1,option->value.size()-2);
 
         //avoid any escaped chars by simply looking for the last occurence of / in the (not anymore) quoted pcre string
         endPosition=temp.find_last_of("/");
-        pcreString=temp.substr(1,endPosition-1);
-        tempRule->body.pcre.push_back(pcreString);
+        match.pattern=temp.substr(1,endPosition-1);
 
         //getting pcre modifiers
         pcreModifierString=temp.substr(endPosition+1,temp.length()-endPosition);
@@ -672,17 +802,16 @@ void parsePcre(std::string* line, int* linecounter, snortRule* tempRule){
         //detailed handling of single pcre modifiers
         iPosition=pcreModifierString.find("i");
         if(iPosition!=std::string::npos){
-        	tempRule->body.pcreNocase.push_back(true);
+        	match.set(ruleMatch::NOCASE,true);
         	pcreModifierString.erase(iPosition,1);
-        }else{
-        	tempRule->body.pcreNocase.push_back(false);
         }
 
         //if no modifiers left, no http modifier, so useless:
         if(pcreModifierString.size()==0){
-        	fprintf(stderr,"Error with rule sid:%s on line %d, failed to parse pcre modifier: No http modifier for pcre, we need at least one\n",tempRule->body.sid.c_str(),*linecounter);
+        	context->print(stderr,"Error with rule sid:%s on line %d, failed to parse pcre modifier: No http modifier for pcre, we need at least one\n",tempRule->body.sid.c_str(),context->linenumber);
         	if(continueOnError==false){
-        		exit(1);
+        		context->fatal=true;
+        		return;
         	}
         }
 
@@ -690,648 +819,4929 @@ void parsePcre(std::string* line, int* linecounter, snortRule* tempRule){
         		||pcreModifierString.find("A")!=std::string::npos||pcreModifierString.find("E")!=std::string::npos
 				||pcreModifierString.find("G")!=std::string::npos||pcreModifierString.find("R")!=std::string::npos
 				||pcreModifierString.find("B")!=std::string::npos||pcreModifierString.find("O")!=std::string::npos){
-        	 fprintf(stderr,"Error with rule sid:%s on line %d, failed to parse pcre modifier: The Snort specific (non HTTP) pcre modifiers s,m,x,A,E,G,R,B,O are not supported.\n",tempRule->body.sid.c_str(),*linecounter);
+        	 context->print(stderr,"Error with rule sid:%s on line %d, failed to parse pcre modifier: The Snort specific (non HTTP) pcre modifiers s,m,x,A,E,G,R,B,O are not supported.\n",tempRule->body.sid.c_str(),context->linenumber);
         	 if(continueOnError==false){
-				exit(1);
+				context->fatal=true;
+				return;
 			}
         }
         for(std::string::size_type k = 0; k < pcreModifierString.size(); ++k) {
-            switch(pcreModifierString[k]){
-            case 'P'://client body
-            	tempRule->body.contentModifierHTTP.push_back(8);
-            	break;
-            case 'H'://http header 6
-            	tempRule->body.contentModifierHTTP.push_back(6);
-				break;
-            case 'D'://raw_header 7
-            	tempRule->body.contentModifierHTTP.push_back(7);
-				break;
-            case 'C'://cookie 9
-            	tempRule->body.contentModifierHTTP.push_back(9);
-				break;
-            case 'K'://raw cookie 19
-            	tempRule->body.contentModifierHTTP.push_back(10);
-            	break;
-            case 'U'://uri
-            	//TODO: it would make sense to check already here for unescaped unsupported or unwise chars, on the other hand snort does accept most of them anyway
-            	tempRule->body.contentModifierHTTP.push_back(2);
-            	break;
-            case 'I'://raw uri
-            	//checkUriPCRE(pcreString);
-            	tempRule->body.contentModifierHTTP.push_back(3);
-            	break;
-            case 'M'://method
-            	tempRule->body.contentModifierHTTP.push_back(1);
-            	break;
-            case 'S'://response code
-            	tempRule->body.contentModifierHTTP.push_back(5);
-            	break;
-            case 'Y'://response message
-            	tempRule->body.contentModifierHTTP.push_back(4);
-            	break;
-            default:
-            	fprintf(stderr,"Error with rule sid:%s on line %d, failed to parse pcre modifier: There was an uncaught, unsupported snort specific modifier. This should not have happened!\n",tempRule->body.sid.c_str(),*linecounter);
+            httpModifier modifier=pcreModifier(pcreModifierString[k]);
+            if(modifier==HTTP_NONE){
+            	context->print(stderr,"Error with rule sid:%s on line %d, failed to parse pcre modifier: There was an uncaught, unsupported snort specific modifier. This should not have happened!\n",tempRule->body.sid.c_str(),context->linenumber);
             	if(continueOnError==false){
-					exit(1);
+					context->fatal=true;
+					return;
 				}
             }
+            //one pcre can only be put into one part of the request
+            if(match.modifier!=HTTP_NONE&&modifier!=HTTP_NONE){
+            	context->print(stderr,"Error with rule sid:%s on line %d, failed to parse pcre modifier: More than one http modifier for pcre, only one is supported\n",tempRule->body.sid.c_str(),context->linenumber);
+            	if(continueOnError==false){
+            		context->fatal=true;
+            		return;
+            	}
+            }else{
+            	match.modifier=modifier;
+            }
         }
+        tempRule->body.matches.push_back(match);
 
         //printf("%s\n",temp.c_str());
-        //printf("%s\n",pcreString.c_str());
         //printf("%s\n",pcreModifierString.c_str());
-
-        //erase pcre keyword from line so that we can move on to next line
-        lineCopy.erase(startPosition-5,5);
-        lineCopySearch.erase(startPosition-5,5);
-        startPosition=lineCopySearch.find("pcre:",bodyStartPosition)+5;
-        endPosition=lineCopySearch.find(";",startPosition);
     }
 
+    //there should definitively be at least one pcre, if not throw an error
+    if(!foundPcre){
+    	parsingError(context,"pcre");
+        context->fatal=true;
+        return;
+    }
 }
 /**
-* parses SID and SID rev. number from given line and writes it to given snortRule struct
+* parses SID and SID rev. number from given rule options and writes it to given snortRule struct
 */
-void parseSid(std::string* line, int* linecounter, snortRule* tempRule){
-                std::string lineCopy=replaceQuotedText(line);
-                std::size_t startPosition=lineCopy.find("sid:",bodyStartPosition)+4;
-                std::size_t endPosition=lineCopy.find(';',startPosition);
-                if(startPosition==3||endPosition==std::string::npos){
-                    parsingError(*linecounter,"SID");
-                    exit(1);
+void parseSid(std::vector<ruleOption>* options, ruleParseContext* context, snortRule* tempRule){
+                unsigned long sidIndex;
+                ruleOption* rev=NULL;
+                for(sidIndex=0;sidIndex<options->size();sidIndex++){
+                	if(options->at(sidIndex).keyword=="sid"){
+                		break;
+                	}
+                }
+                if(sidIndex==options->size()){
+                    parsingError(context,"SID");
+                    context->fatal=true;
+                    return;
                 }
-                tempRule->body.sid=lineCopy.substr(startPosition,(endPosition-startPosition));
+                tempRule->body.sid=options->at(sidIndex).value;
 
                 //parse rev following SID
-                startPosition=lineCopy.find("rev:",startPosition)+4;
-                endPosition=lineCopy.find(';',startPosition);
-                if(startPosition==3||endPosition==std::string::npos){
-                    parsingError(*linecounter,"SID revision");
-                    exit(1);
+                rev=findRuleOption(options,"rev",sidIndex+1);
+                if(rev==NULL){
+                    parsingError(context,"SID revision");
+                    context->fatal=true;
+                    return;
                 }
-                tempRule->body.rev=lineCopy.substr(startPosition,(endPosition-startPosition));
+                tempRule->body.rev=rev->value;
 }
 
-/*
-*Function that is used to handle return data from sent requests
-*/
-size_t write_data(void *buffer, size_t size, size_t nmemb, void *userp){
+/**
+ * positions of the ruleKeywords in one rule line, see ruleKeywordScanner
+ */
+class ruleKeywordMatches {
+	public:
+		//bit k is set if ruleKeyword k is in the line
+		uint32_t found=0;
+		//position of the first occurrence of every keyword that was found
+		std::size_t first[RULEKEYWORDCOUNT];
 
-        //ev. print response which resides in buffer
-		if(printResponse){
+		bool has(ruleKeyword keyword) const{
+			return (found&(1U<<keyword))!=0;
 		}
-        return size*nmemb;
-}
 
-/**
- * removes \r and \n at beginning and end of strings
- */
-std::string removeCRLF(std::string str, std::string ruleSid){
-	if(str.size()==0){
-		fprintf(stderr,"Error, can not sanitize empty Header for rulesid:%s. Likely, this rule produced an empty pcre string, check pcre.\n",ruleSid.c_str());
-		if(continueOnError==false){
-			exit(0);
+		std::size_t position(ruleKeyword keyword) const{
+			return has(keyword)?first[keyword]:std::string::npos;
 		}
-	}
-	//remove all \r and \n at end, libcurl will add them anyway
-	while((str.at(str.size()-1)=='n'&&str.at(str.size()-2)=='\\')||(str.at(str.size()-1)=='r'&&str.at(str.size()-2)=='\\')){
-		str.pop_back();
-		str.pop_back();
-	}
-	//snort rules also search for \r\n at beginning of some fields, remove them too:
-	while((str.at(0)=='\\'&&str.at(1)=='r')||(str.at(0)=='\\'&&str.at(1)=='n')){
-		str.erase(0,2);
-	}
-	if(str==""){
-		fprintf(stderr,"WARNING: Empty String after removing initial and trailing newlines. sid: %s\n",str.c_str());
-	}
-	return str;
-}
 
+		/**
+		 * the first keyword from..to (in enum order) that is in the line, -1 if none is
+		 */
+		int firstOf(ruleKeyword from, ruleKeyword to) const{
+			for(int keyword=from;keyword<=to;keyword++){
+				if(has((ruleKeyword)keyword)){
+					return keyword;
+				}
+			}
+			return -1;
+		}
+};
 
 /**
- * 2 steps:
- * 1:remove excess \r\n at end and beginning. libcurl adds a \r\n anyway, so we have to remove them.
- * 2:if colon OR colon+whitespace at end of header are found a value is added.
- * 	WHY?: if a header without a value is set, curl assumes you want to remove the original header, so we have to set a value after colon or colon and space:
+ * finds all ruleKeywords in a rule line in a single pass (Aho-Corasick automaton), instead of searching the whole line again for every keyword.
+ * Bytes that are in no keyword share one column of the transition table, so the table stays small. It is only read while scanning,
+ * so all parser threads use the same scanner
  */
-std::string sanitizeHeader(std::string header, std::string ruleSid){
-	if(header.size()==0){
-		fprintf(stderr,"Error, can not sanitize empty Header for rulesid:%s. Likely, this rule produced an empty pcre string, check pcre.\n",ruleSid.c_str());
-		if(continueOnError==false){
-			exit(0);
-		}
-	}else{
-		header=removeCRLF(header,ruleSid);
-		//add dummystuff if missing
-		if(header.at(header.size()-1)==':'){
-			header=header+" DummyValue";
-			if(verbose){
-				printf("INFO: added dummy value to incomplete name: value header. sid:%s\n",ruleSid.c_str());
+class ruleKeywordScanner {
+	public:
+		ruleKeywordScanner(){
+			std::vector<uint16_t> fail;
+			std::deque<uint16_t> queue;
+			memset(byteClass,0,sizeof(byteClass));
+			classes=1;
+			for(int keyword=0;keyword<RULEKEYWORDCOUNT;keyword++){
+				for(const char* c=ruleKeywordStrings[keyword];*c!='\0';c++){
+					if(byteClass[(unsigned char)*c]==0){
+						byteClass[(unsigned char)*c]=classes++;
+					}
+				}
 			}
-		}else if(header.at(header.size()-1)==' '&&header.at(header.size()-2)==':'){
-			header=header+"DummyValue";
-			if(verbose){
-				printf("INFO: added dummy value to incomplete name: value header. sid:%s\n",ruleSid.c_str());
+			//trie of all keywords
+			addState();
+			for(int keyword=0;keyword<RULEKEYWORDCOUNT;keyword++){
+				uint16_t state=0;
+				length[keyword]=strlen(ruleKeywordStrings[keyword]);
+				for(const char* c=ruleKeywordStrings[keyword];*c!='\0';c++){
+					uint16_t* next=&transitions[state*classes+byteClass[(unsigned char)*c]];
+					if(*next==NOSTATE){
+						//addState() moves the table
+						uint16_t added=addState();
+						next=&transitions[state*classes+byteClass[(unsigned char)*c]];
+						*next=added;
+					}
+					state=*next;
+				}
+				outputs[state]|=1U<<keyword;
 			}
-		}else if(header.find(':')==std::string::npos){
-			header="DummyHeader: "+header;
-			if(verbose){
-				printf("INFO: added dummy value to incomplete name: value header. sid:%s\n",ruleSid.c_str());
+			//breadth first, so the failure state of every state is complete before the state itself
+			fail.assign(outputs.size(),0);
+			for(uint16_t byteClassIndex=0;byteClassIndex<classes;byteClassIndex++){
+				uint16_t* next=&transitions[byteClassIndex];
+				if(*next==NOSTATE){
+					*next=0;
+				}else{
+					queue.push_back(*next);
+				}
+			}
+			while(!queue.empty()){
+				uint16_t state=queue.front();
+				queue.pop_front();
+				outputs[state]|=outputs[fail[state]];
+				for(uint16_t byteClassIndex=0;byteClassIndex<classes;byteClassIndex++){
+					uint16_t* next=&transitions[state*classes+byteClassIndex];
+					uint16_t fallback=transitions[fail[state]*classes+byteClassIndex];
+					if(*next==NOSTATE){
+						*next=fallback;
+					}else{
+						fail[*next]=fallback;
+						queue.push_back(*next);
+					}
+				}
 			}
 		}
 
-	}
-	if(header==""){
-		fprintf(stderr,"WARNING: Empty header after sanitazion. sid: %s\n",ruleSid.c_str());
-	}
-	return header;
-}
+		void scan(std::string_view line, ruleKeywordMatches* matches) const{
+			uint16_t state=0;
+			matches->found=0;
+			for(std::size_t i=0;i<line.size();i++){
+				state=transitions[state*classes+byteClass[(unsigned char)line[i]]];
+				uint32_t newKeywords=outputs[state]&~matches->found;
+				while(newKeywords!=0){
+					int keyword=__builtin_ctz(newKeywords);
+					matches->first[keyword]=i+1-length[keyword];
+					matches->found|=1U<<keyword;
+					newKeywords&=newKeywords-1;
+				}
+			}
+		}
+
+	private:
+		static constexpr uint16_t NOSTATE=0xffff;
+		uint8_t byteClass[256];
+		uint16_t classes;
+		std::size_t length[RULEKEYWORDCOUNT];
+		//transitions[state*classes+byteClass], every state has a transition for every class
+		std::vector<uint16_t> transitions;
+		//bit k is set if ruleKeyword k ends in this state
+		std::vector<uint32_t> outputs;
+
+		uint16_t addState(){
+			transitions.resize(transitions.size()+classes,NOSTATE);
+			outputs.push_back(0);
+			return outputs.size()-1;
+		}
+};
+
+const ruleKeywordScanner ruleKeywords;
 
 /**
- * this function replaces character classes that are not supported by the exrex and problematic chars by equivalent signs
+ * sorts out rules we are not interested in and parses the given rule line into tempRule.
+ * Returns true if the rule should be used. All messages go to the context, if parsing has to abort the run context->fatal is set.
  */
-std::string sanitizePCRE(std::string pcre, std::string sid){
-    std::size_t index;
-	//replace \s with " ", so whitespace chars become just whitespace and not something like newlines
-	while(true){
-		index=pcre.find("\\s");
-		if(index==std::string::npos){
-			break;
-		}else{
-			pcre.replace(index,2," ");
-			index+=3;
-			if(verbose){
-				printf("INFO: replaced \\s with single whitespace before generation. sid:%s\n",sid.c_str());
-			}
-		}
+bool parseRuleLine(std::string_view line, ruleParseContext* context, snortRule* tempRule){
+	std::size_t alertPosition;
+	std::size_t contentPosition;
+	std::size_t pcrePosition;
+	ruleKeywordMatches keywords;
+	int keyword;
+	bool pushRule=true;
+
+	//check if rule is a comment, if yes-> ignore
+	if(line.substr(0,1)=="#"){
+		context->rejection=REJECT_COMMENT;
+		return false;
+	}
+	//one pass over the line finds every keyword the checks below look for
+	ruleKeywords.scan(line,&keywords);
+	//check if rule is alert and if it contains content keyword, almost all rules do and if not it is not interesting for us
+	alertPosition=line.substr(0,6).find("alert");
+	contentPosition=keywords.position(KEYWORD_CONTENT);
+	pcrePosition=keywords.position(KEYWORD_PCRE);
+	//sort out rules that we are not interested in
+	if(alertPosition==std::string::npos){
+		context->print(stdout,"WARNING: Rule in line number %d, does not contain alert keyword. Ignored\n",context->linenumber);
+		context->rejection=REJECT_NOALERT;
+		return false;
+	//the following check inherently also checks for uricontent: keyword
+	}else if((contentPosition==std::string::npos)&&(pcrePosition==std::string::npos)){
+		context->print(stdout,"WARNING: Rule in line number %d, does not contain content or pcre keyword. Ignored\n",context->linenumber);
+		context->rejection=REJECT_NOCONTENT;
+		return false;
+	}else if((keyword=keywords.firstOf(KEYWORD_FLOWBITS,KEYWORD_DEPTH))>=0){
+		context->print(stdout,"WARNING: Rule in line number %d, contains keyword for byte ranges (flowbits,distance,within,depth,offset) which is not supported. Ignored\n",context->linenumber);
+		context->rejection=REJECT_KEYWORD+keyword;
+		return false;
+	}else if((keyword=keywords.firstOf(KEYWORD_DCE,KEYWORD_DETECTIONFILTER))>=0){
+		context->print(stdout,"WARNING: Rule in line number %d, contains one of the following not supported keywords: dce_*, threshold:, urilen:, detectionfilter. Ignored\n",context->linenumber);
+		context->rejection=REJECT_KEYWORD+keyword;
+		return false;
+	}else if(!responseRules&&(keyword=keywords.firstOf(KEYWORD_FROMSERVER,KEYWORD_TOCLIENT))>=0){
+		context->print(stdout,"WARNING: Rule looks for packet coming from server ('from_server' or 'to_client' keyword). Can not control server responses. Rule ignored in line: %d\n",context->linenumber);
+		context->rejection=REJECT_KEYWORD+keyword;
+		return false;
+	}else if(keywords.has(KEYWORD_CONTENTSPACE)){
+		context->print(stdout,"WARNING: Content pattern does not start immediately after content keyword. I don't like that. Fix it. Rule ignored in line: %d\n",context->linenumber);
+		context->rejection=REJECT_KEYWORD+KEYWORD_CONTENTSPACE;
+		return false;
 	}
 
-	//replace +? with +
-	while(true){
-		index=pcre.find("+?");
-		if(index==std::string::npos){
-			break;
-		}else{
-			pcre.replace(index,2,"+");
-			if(verbose){
-				printf("INFO: replaced +? with + in pcre before generation. sid:%s\n",sid.c_str());
+	//split the rule body into its options once, all parse functions work on them
+	std::vector<ruleOption> options;
+	tokenizeRuleBody(line,&options);
+
+	//parse sid first, so we can print this info in error msgs
+	parseSid(&options,context,tempRule);
+	if(context->fatal){
+		return false;
+	}
+	parseHeader(line,context,tempRule);
+	if(context->fatal){
+		return false;
+	}
+	parseMsg(&options,context,tempRule);
+	if(context->fatal){
+		return false;
+	}
+
+	//it might contain no content (just pcre), than skip parseContent
+	if(contentPosition!=std::string::npos){
+		//if uricontent, skip next test because no http_ is intended
+		if(line.substr(contentPosition-3,3)!="uri"){
+			if(!keywords.has(KEYWORD_HTTP)){
+				context->print(stdout,"WARNING: Rule in line number %d contains content keyword but no http_ content modifier. Content part ignored\n", context->linenumber);
 			}
 		}
+		parseContent(&options,context,tempRule);
+		if(context->fatal){
+			return false;
+		}
+		parseContentModifier(&options,context,tempRule);
+		if(context->fatal){
+			return false;
+		}
+	}
+	if(pcrePosition!=std::string::npos){
+		parsePcre(&options,context,tempRule);
+		if(context->fatal){
+			return false;
+		}
 	}
 
-	//replace *? with *
-	while(true){
-		index=pcre.find("*?");
-		if(index==std::string::npos){
-			break;
-		}else{
-			pcre.replace(index,2,"*");
-			if(verbose){
-				printf("INFO: replaced *? with * in pcre before generation. sid:%s\n",sid.c_str());
-			}
+	//do not allow rules which have no http_ content modifier
+	for (unsigned long i = 0; i < tempRule->body.matches.size();i++) {
+		if (!tempRule->body.matches[i].has(ruleMatch::PCRE)&&tempRule->body.matches[i].modifier == HTTP_NONE) {
+			pushRule = false;
+			context->rejection=REJECT_NOHTTPMODIFIER;
+			context->print(stdout,"WARNING: Rule with sid:%s in line number %d, contains at least one content without http_* content modifier. Ignored\n", tempRule->body.sid.c_str(), context->linenumber);
 		}
 	}
 
-	//replace .+ with [a-z] so that it produces easy to use char and not some weird sh**
-	while(true){
-		index=pcre.find(".+");
-		if(index==std::string::npos){
-			break;
-		}else{
-			pcre.replace(index,2,"[a-z]}");
-			if(verbose){
-				printf("INFO: replaced .+ with [a-z] in pcre before generation. sid:%s\n",sid.c_str());
-			}
+	if(continueOnError==false){
+		//before pushing rule, check if it makes sense. this will abort the run if it fails.
+		plausabilityCheck(tempRule,context);
+		if(context->fatal){
+			return false;
 		}
 	}
+	return pushRule;
+}
 
-	//replace .* with [a-z] so that it produces easy to use char and not some weird sh**
-	while(true){
-		index=pcre.find(".*");
-		if(index==std::string::npos){
-			break;
-		}else{
-			pcre.replace(index,2,"[a-z]");
-			if(verbose){
-				printf("INFO: replaced .* with [a-z] in pcre before generation. sid:%s\n",sid.c_str());
+/**
+ * result of parsing one line of the rule file
+ */
+class parsedLine {
+	public:
+		ruleParseContext context;
+		snortRule rule;
+		bool pushRule=false;
+};
+
+/**
+ * counts why rule file lines were not used, printed at the end of the run so it is clear how much of a rule set is not supported and why
+ */
+class ruleLineStatistics {
+	public:
+		void add(const parsedLine* line){
+			lines++;
+			if(line->pushRule){
+				used++;
+			}else{
+				rejected[line->context.rejection]++;
 			}
 		}
-	}
 
-	//replace .? with [a-z] so that it produces easy to use char and not some weird sh**
-	while(true){
-		index=pcre.find(".?");
-		if(index==std::string::npos){
-			break;
-		}else{
-			pcre.replace(index,2,"[a-z]");
-			if(verbose){
-				printf("INFO: replaced .? with [a-z] in pcre before generation. sid:%s\n",sid.c_str());
+		void report(){
+			std::vector<std::pair<unsigned long,int> > reasons;
+			if(lines==0){
+				return;
 			}
+			for(int reason=REJECT_NONE;reason<REJECT_KEYWORD+RULEKEYWORDCOUNT;reason++){
+				if(rejected[reason]>0){
+					reasons.push_back(std::make_pair(rejected[reason],reason));
+				}
+			}
+			std::sort(reasons.rbegin(),reasons.rend());
+			//one write, so lines of worker processes do not get mixed into the report
+			std::string report="Rule lines: "+std::to_string(lines)+" parsed, "+std::to_string(used)+" used, "+std::to_string(lines-used)+" not used\n";
+			for(unsigned long i=0;i<reasons.size();i++){
+				char line[128];
+				snprintf(line,sizeof(line),"\t%10lu (%5.1f%%) ",reasons[i].first,100.0*reasons[i].first/lines);
+				report+=line+reasonName(reasons[i].second)+"\n";
+			}
+			fputs(report.c_str(),stdout);
 		}
-	}
 
-	while(true){
-		index=pcre.find("[^&]");
-		if(index==std::string::npos){
-			break;
-		}else{
-			pcre.replace(index,4,"[a-z]");
-			if(verbose){
-				printf("INFO: replaced [^&] with [a-z] in pcre before generation. sid:%s\n",sid.c_str());
+		/**
+		 * all counters in one list, so the rule cache can store them with the rules
+		 */
+		std::vector<uint64_t> counts(){
+			std::vector<uint64_t> values={lines,used};
+			values.insert(values.end(),rejected,rejected+REJECT_KEYWORD+RULEKEYWORDCOUNT);
+			return values;
+		}
+
+		/**
+		 * takes the counters from counts(), returns false if they were written for other reject reasons
+		 */
+		bool setCounts(const std::vector<uint64_t>& values){
+			if(values.size()!=2+REJECT_KEYWORD+RULEKEYWORDCOUNT){
+				return false;
+			}
+			lines=values[0];
+			used=values[1];
+			std::copy(values.begin()+2,values.end(),rejected);
+			return true;
+		}
+
+	private:
+		unsigned long lines=0;
+		unsigned long used=0;
+		unsigned long rejected[REJECT_KEYWORD+RULEKEYWORDCOUNT]={0};
+
+		std::string reasonName(int reason){
+			switch(reason){
+				case REJECT_COMMENT:
+					return "comment";
+				case REJECT_NOALERT:
+					return "no alert keyword";
+				case REJECT_NOCONTENT:
+					return "no content or pcre";
+				case REJECT_NOHTTPMODIFIER:
+					return "content without http_* modifier";
+				case REJECT_KEYWORD+KEYWORD_CONTENTSPACE:
+					return "space after content:";
+				case REJECT_NONE:
+					return "not used";
+				default:
+					return std::string("keyword ")+ruleKeywordStrings[reason-REJECT_KEYWORD];
+			}
+		}
+};
+
+ruleLineStatistics lineStatistics;
+
+/**
+ * parses the given lines with numberOfThreads threads, lines[i] is line number firstLinenumber+i of the rule file
+ * or linenumbers[i] if the lines are not consecutive. results[i] holds the result of lines[i], so results can be merged in file order.
+ */
+void parseRuleLines(std::vector<std::string_view>* lines, int firstLinenumber, std::vector<parsedLine>* results, int numberOfThreads,
+		const std::vector<int>* linenumbers=NULL){
+	std::atomic<unsigned long> nextChunk(0);
+	std::vector<std::thread> workers;
+	results->clear();
+	results->resize(lines->size());
+
+	//lines are handed out in chunks, so threads do not fight over every single line
+	auto worker=[&](){
+		unsigned long start;
+		while((start=nextChunk.fetch_add(PARSECHUNKSIZE))<lines->size()){
+			unsigned long end=std::min(start+PARSECHUNKSIZE,(unsigned long)lines->size());
+			for(unsigned long i=start;i<end;i++){
+				parsedLine* result=&results->at(i);
+				result->context.linenumber=linenumbers!=NULL?linenumbers->at(i):firstLinenumber+i;
+				result->pushRule=parseRuleLine(lines->at(i),&result->context,&result->rule);
 			}
 		}
+	};
+	numberOfThreads=std::min(numberOfThreads,(int)((lines->size()+PARSECHUNKSIZE-1)/PARSECHUNKSIZE));
+	for(int i=1;i<numberOfThreads;i++){
+		workers.push_back(std::thread(worker));
 	}
+	worker();
+	for(unsigned long i=0;i<workers.size();i++){
+		workers[i].join();
+	}
+}
 
-	while(true){
-			index=pcre.find("[^\\]");
-			if(index==std::string::npos){
-				break;
-			}else{
-				pcre.replace(index,4,"[a-z]");
-				if(verbose){
-					printf("INFO: replaced [^\\] with [a-z] in pcre before generation. sid:%s\n",sid.c_str());
+/**
+ * read only view of a whole file, memory mapped if possible so lines can be parsed without copying them.
+ * Falls back to reading the file into memory for files that can not be mapped, e.g. pipes.
+ */
+class mappedFile {
+	public:
+		~mappedFile(){
+			if(mapped!=NULL){
+				munmap(mapped,mappedSize);
+			}
+		}
+
+		/**
+		 * maps the given file, returns false if it can not be opened
+		 */
+		bool open(std::string fileName){
+			struct stat fileStat;
+			int fd=::open(fileName.c_str(),O_RDONLY);
+			if(fd<0){
+				return false;
+			}
+			if(fstat(fd,&fileStat)==0&&S_ISREG(fileStat.st_mode)&&fileStat.st_size>0){
+				void* map=mmap(NULL,fileStat.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+				if(map!=MAP_FAILED){
+					mapped=(char*)map;
+					mappedSize=fileStat.st_size;
+					//the file is read front to back exactly once
+					madvise(mapped,mappedSize,MADV_SEQUENTIAL);
+					contents=std::string_view(mapped,mappedSize);
+					::close(fd);
+					return true;
 				}
 			}
+			char buffer[65536];
+			ssize_t bytesRead;
+			while((bytesRead=read(fd,buffer,sizeof(buffer)))>0){
+				copy.append(buffer,bytesRead);
+			}
+			::close(fd);
+			contents=copy;
+			return bytesRead==0;
 		}
 
-	while(true){
-			index=pcre.find("[^\\n]");
-			if(index==std::string::npos){
-				break;
+		std::string_view data(){
+			return contents;
+		}
+
+		/**
+		 * the file is read again from the beginning, released parts are read from disk again
+		 */
+		void rewind(){
+			released=0;
+		}
+
+		/**
+		 * tells the kernel that everything before the given offset is not needed anymore, keeps the resident size of huge files small
+		 */
+		void release(std::size_t offset){
+			long pageSize=sysconf(_SC_PAGESIZE);
+			std::size_t end=offset-offset%pageSize;
+			if(mapped==NULL||end<=released){
+				return;
+			}
+			madvise(mapped+released,end-released,MADV_DONTNEED);
+			released=end;
+		}
+
+	private:
+		char* mapped=NULL;
+		std::size_t mappedSize=0;
+		std::size_t released=0;
+		//only used if the file could not be mapped
+		std::string copy;
+		std::string_view contents;
+};
+
+/**
+ * captures responses to a file without slowing down sending: the sender only appends records to an in-memory buffer,
+ * full buffers are written by a thread of their own. If the disk can not keep up, whole buffers are dropped and counted.
+ * Every sending process has its own capture. The file is either text or a length-prefixed binary log and can be rotated.
+ */
+class responseCapture {
+	public:
+		enum formatType {TEXT, BINARY};
+		formatType format=TEXT;
+		//bytes of every response that are kept, the rest is cut off
+		std::size_t maxLength=CAPTUREMAXDEFAULT;
+		//start a new file after this many bytes, 0 never rotates. Files are rotated between buffers, so records are never split
+		uint64_t rotateBytes=0;
+		unsigned long captured=0;
+		unsigned long truncated=0;
+		unsigned long dropped=0;
+
+		~responseCapture(){
+			close();
+		}
+
+		/**
+		 * opens the capture file, - for stdout, and starts the writer thread
+		 */
+		bool open(std::string name){
+			fileName=name;
+			if(!openFile()){
+				return false;
+			}
+			//small rotation sizes need smaller buffers, files are only rotated between them
+			bufferSize=CAPTUREBUFFERSIZE;
+			if(rotateBytes>0&&rotateBytes<bufferSize){
+				bufferSize=rotateBytes;
+			}
+			current.reserve(bufferSize);
+			writer=std::thread(&responseCapture::writeBuffers,this);
+			return true;
+		}
+
+		/**
+		 * adds up to maxLength bytes of the response data to what curl delivered so far for a transfer, length counts all bytes
+		 */
+		void collect(std::string* response, std::size_t* length, const char* data, std::size_t dataLength){
+			*length+=dataLength;
+			if(response->size()<maxLength){
+				response->append(data,std::min(dataLength,maxLength-response->size()));
+			}
+		}
+
+		/**
+		 * adds the response to a request of the given sid, length is the length of the whole response and data holds at least its first maxLength bytes
+		 */
+		void add(const std::string& sid, long status, const char* data, std::size_t length){
+			std::size_t kept=std::min(length,maxLength);
+			if(kept<length){
+				truncated++;
+			}
+			if(format==TEXT){
+				char header[128];
+				snprintf(header,sizeof(header),"--- sid:%.64s status:%ld length:%lu%s\n",sid.c_str(),status,(unsigned long)length,kept<length?" truncated":"");
+				current.append(header);
+				current.append(data,kept);
+				current.push_back('\n');
 			}else{
-				pcre.replace(index,5,"[a-z]");
-				if(verbose){
-					printf("INFO: replaced [^\\n] with [a-z] in pcre before generation. sid:%s\n",sid.c_str());
-				}
+				uint32_t sidLength=sid.size();
+				int32_t statusCode=status;
+				uint64_t fullLength=length;
+				uint32_t keptLength=kept;
+				current.append((const char*)&sidLength,sizeof(sidLength));
+				current.append(sid);
+				current.append((const char*)&statusCode,sizeof(statusCode));
+				current.append((const char*)&fullLength,sizeof(fullLength));
+				current.append((const char*)&keptLength,sizeof(keptLength));
+				current.append(data,kept);
+			}
+			captured++;
+			currentRecords++;
+			if(current.size()>=bufferSize){
+				handOver();
 			}
 		}
 
-	while(true){
-				index=pcre.find("[^\\r\\n]");
-				if(index==std::string::npos){
-					break;
+		/**
+		 * writes everything that is left, stops the writer thread and prints what was captured
+		 */
+		void close(){
+			if(!writer.joinable()){
+				return;
+			}
+			handOver();
+			{
+				std::lock_guard<std::mutex> lock(queueLock);
+				done=true;
+			}
+			queueChanged.notify_one();
+			writer.join();
+			if(file!=stdout){
+				fclose(file);
+			}
+			file=NULL;
+			fprintf(stderr,"Captured %lu responses (%lu truncated to %lu bytes, %lu dropped because writing could not keep up)\n",
+					captured-dropped,truncated,(unsigned long)maxLength,dropped);
+		}
+
+	private:
+		std::string fileName;
+		FILE* file=NULL;
+		int fileIndex=0;
+		uint64_t fileBytes=0;
+		//records are appended here by the sender
+		std::string current;
+		std::size_t bufferSize=CAPTUREBUFFERSIZE;
+		unsigned long currentRecords=0;
+		//full buffers and their number of records, waiting for the writer thread
+		std::deque<std::pair<std::string,unsigned long> > queue;
+		std::mutex queueLock;
+		std::condition_variable queueChanged;
+		bool done=false;
+		std::thread writer;
+
+		bool openFile(){
+			std::string name=fileIndex==0?fileName:fileName+"."+std::to_string(fileIndex);
+			file=fileName=="-"?stdout:fopen(name.c_str(),"w");
+			if(file==NULL){
+				return false;
+			}
+			//only records count for rotation
+			fileBytes=0;
+			if(format==BINARY){
+				fwrite(CAPTUREMAGIC,1,sizeof(CAPTUREMAGIC)-1,file);
+			}
+			return true;
+		}
+
+		/**
+		 * queues the current buffer for the writer, never waits for it
+		 */
+		void handOver(){
+			if(current.empty()){
+				return;
+			}
+			std::string full;
+			full.reserve(bufferSize);
+			full.swap(current);
+			{
+				std::lock_guard<std::mutex> lock(queueLock);
+				if(queue.size()>=CAPTUREQUEUEDEPTH){
+					dropped+=currentRecords;
 				}else{
-					pcre.replace(index,7,"[a-z]");
-					if(verbose){
-						printf("INFO: replaced [^\\r\\n] with [a-z] in pcre before generation. sid:%s\n",sid.c_str());
-					}
-				}
-			}
-//	while(true){
-//					index=pcre.find("[^\\0A\\0D]");
-//					if(index==std::string::npos){
-//						break;
-//					}else{
-//						pcre.replace(index,9,"[a-z]");
-//						if(verbose){
-//							printf("INFO: replaced [^\\0A\\0D] with [a-z] in pcre before generation. sid:%s\n",sid.c_str());
-//						}
-//					}
-//				}
-//	while(true){
-//					index=pcre.find("[^\\x26\\x3B]");
-//					if(index==std::string::npos){
-//						break;
-//					}else{
-//						pcre.replace(index,11,"[a-z]");
-//						if(verbose){
-//							printf("INFO: replaced [^\\x26\\x3B] with [a-z] in pcre before generation. sid:%s\n",sid.c_str());
-//						}
-//					}
-//				}
-	while(true){
-					index=pcre.find("[^\\x2f]");
-					if(index==std::string::npos){
-						break;
-					}else{
-						pcre.replace(index,7,"[a-z]");
-						if(verbose){
-							printf("INFO: replaced [^\\x2f] with [a-z] in pcre before generation. sid:%s\n",sid.c_str());
-						}
+					queue.push_back(std::make_pair(std::move(full),currentRecords));
+				}
+			}
+			currentRecords=0;
+			queueChanged.notify_one();
+		}
+
+		void writeBuffers(){
+			std::unique_lock<std::mutex> lock(queueLock);
+			while(true){
+				queueChanged.wait(lock,[this](){return done||!queue.empty();});
+				if(queue.empty()){
+					return;
+				}
+				std::string buffer=std::move(queue.front().first);
+				queue.pop_front();
+				lock.unlock();
+				if(rotateBytes>0&&fileBytes>0&&fileBytes+buffer.size()>rotateBytes&&file!=stdout){
+					fclose(file);
+					fileIndex++;
+					if(!openFile()){
+						fprintf(stderr,"Unable to open response capture file %s.%d, responses are not captured anymore\n",fileName.c_str(),fileIndex);
+						file=fopen("/dev/null","w");
 					}
 				}
-//	while(true){
-//					index=pcre.find("[^\\s\\x26\\x3B\\x2f]");
-//					if(index==std::string::npos){
-//						break;
-//					}else{
-//						pcre.replace(index,17,"[a-z]");
-//						if(verbose){
-//							printf("INFO: replaced [^\\s\\x26\\x3B\\x2f] with [a-z] in pcre before generation. sid:%s\n",sid.c_str());
-//						}
-//					}
-//				}
+				fileBytes+=fwrite(buffer.data(),1,buffer.size(),file);
+				lock.lock();
+			}
+		}
+};
 
-	return pcre;
+//captures responses if set, see --response
+responseCapture* responseSink=NULL;
+
+/*
+*Function that is used to handle return data (header and body) from sent requests
+*/
+size_t write_data(void *buffer, size_t size, size_t nmemb, void *userp){
+
+        //keep the response for the capture, userp is the transfer if responses are captured
+		if(userp!=NULL){
+			rulePacketTransfer* transfer=(rulePacketTransfer*)userp;
+			responseSink->collect(&transfer->response,&transfer->responseLength,(const char*)buffer,size*nmemb);
+		}
+        return size*nmemb;
 }
+
 /**
- * generate string from given pcre (with external command)
+ * removes \r and \n at beginning and end of strings
  */
-std::string generateStringFromPCRE(std::string pcreString){
-	//pcre payload generation with the help of an external perl script. This script MUST be present in the same folder as this executable file.
-	//this opens a shell and executes above command (or script), if script is not found a line is written and program continues
-    //hardcoded command name. Of course, this command must exist!!!
-    FILE *commandFile;
-	const int BUFSIZE = 1000;
-	char buf[ BUFSIZE ];
-	std::string command="exrex -r ";
-	std::string popenCommand=command+pcreString;
-	if(verbose){
-		printf("INFO: Command for pcre string generation: %s\n",popenCommand.c_str());
+std::string removeCRLF(std::string str, std::string ruleSid){
+	if(str.size()==0){
+		fprintf(stderr,"Error, can not sanitize empty Header for rulesid:%s. Likely, this rule produced an empty pcre string, check pcre.\n",ruleSid.c_str());
+		if(continueOnError==false){
+			exit(0);
+		}
 	}
-	commandFile = popen( popenCommand.c_str(), "r" );
-	if ( commandFile == NULL ) {
-		fprintf( stderr, "Could not execute command %s to generate regex payload.\n",popenCommand.c_str() );
-		exit(-1);
+	//remove all \r and \n at end, libcurl will add them anyway
+	while((str.at(str.size()-1)=='n'&&str.at(str.size()-2)=='\\')||(str.at(str.size()-1)=='r'&&str.at(str.size()-2)=='\\')){
+		str.pop_back();
+		str.pop_back();
 	}
-	//write result to buf
-	while( fgets( buf, BUFSIZE,  commandFile )) {
-		//fprintf( stdout, "%s", buf  );
+	//snort rules also search for \r\n at beginning of some fields, remove them too:
+	while((str.at(0)=='\\'&&str.at(1)=='r')||(str.at(0)=='\\'&&str.at(1)=='n')){
+		str.erase(0,2);
 	}
-	std::string pcrePayload=buf;
-	pclose( commandFile );
-	return pcrePayload;
+	if(str==""){
+		fprintf(stderr,"WARNING: Empty String after removing initial and trailing newlines. sid: %s\n",str.c_str());
+	}
+	return str;
 }
+
+
 /**
- * sends an HTTP request to the given host containing the pattern(s) of the given rule
+ * 2 steps:
+ * 1:remove excess \r\n at end and beginning. libcurl adds a \r\n anyway, so we have to remove them.
+ * 2:if colon OR colon+whitespace at end of header are found a value is added.
+ * 	WHY?: if a header without a value is set, curl assumes you want to remove the original header, so we have to set a value after colon or colon and space:
  */
-void sendRulePacket(snortRule* rule, std::string host,bool verbose){
-    //initialize all stuff needed for sending packets with curl
-	//NOTE:it would be much more performant to give this method a handle, but libcurl resends cookies from the last http request!!! This was the only option found. And in the end its not really slower...
-    curl_global_init(CURL_GLOBAL_ALL);
-    CURL *handle;
-    //using easy interface, no need for simultaneous transfers
-    handle = curl_easy_init();
-    CURLcode result;
-    std::string hostUri="";
-    std::string cookies="";
-    //we generally add 6 chars to the client body because
-    //Snort does not do any pattern matching if there are less than 6 chars
-    std::string clientBody="12345";
-	//list for custom headers, here we put the sid number to correlate the request with a rule and additional http_header fields
-	struct curl_slist *header=NULL;
-	long httpResponseCode=0;
-	std::string pcrePayload;
+std::string sanitizeHeader(std::string header, std::string ruleSid){
+	if(header.size()==0){
+		fprintf(stderr,"Error, can not sanitize empty Header for rulesid:%s. Likely, this rule produced an empty pcre string, check pcre.\n",ruleSid.c_str());
+		if(continueOnError==false){
+			exit(0);
+		}
+	}else{
+		header=removeCRLF(header,ruleSid);
+		//add dummystuff if missing
+		if(header.at(header.size()-1)==':'){
+			header=header+" DummyValue";
+			if(verbose){
+				printf("INFO: added dummy value to incomplete name: value header. sid:%s\n",ruleSid.c_str());
+			}
+		}else if(header.at(header.size()-1)==' '&&header.at(header.size()-2)==':'){
+			header=header+"DummyValue";
+			if(verbose){
+				printf("INFO: added dummy value to incomplete name: value header. sid:%s\n",ruleSid.c_str());
+			}
+		}else if(header.find(':')==std::string::npos){
+			header="DummyHeader: "+header;
+			if(verbose){
+				printf("INFO: added dummy value to incomplete name: value header. sid:%s\n",ruleSid.c_str());
+			}
+		}
 
+	}
+	if(header==""){
+		fprintf(stderr,"WARNING: Empty header after sanitazion. sid: %s\n",ruleSid.c_str());
+	}
+	return header;
+}
 
-    if(verbose){
-    	fprintf(stdout,"\n--------------------------------------------------------\n");
-    	fprintf(stdout,"INFO: Starting to generate packet # %d, for ruleSid %s\n", packetCounter, rule->body.sid.c_str());
-    	fprintf(stdout,"--------------------------------------------------------\n");
-    }
-	//reset everything, necessary because curl remembers last cookie and sends it again
-	//curl_easy_reset(handle);
-	//with the following curl reports an error for every fail message of the server e.g. 404, 403 but not 100...
-	//curl_easy_setopt (handle, CURLOPT_FAILONERROR, 1L);
-	//tell curl to use custom function to handle return data instead of writing it to stdout
-	curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, write_data);
-	//use http protocol, is default anyway so just to make sure
-	curl_easy_setopt(handle, CURLOPT_PROTOCOLS, CURLPROTO_HTTP);
-	//set http GET as default method, will be changed in case, this is necessary when using CURLOPT_CUSTOMREQUEST
-	curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, NULL);
-	curl_easy_setopt(handle, CURLOPT_HTTPGET, 1L);
-	//remove Accept: */* header which libcurl sets by default
-	header=curl_slist_append(header,"Accept:");
-	//remove Content-Type header which libcurl sets by default for POST request, and which makes good sense but is not mandatory. It can still be added by a rule later on.
-	header=curl_slist_append(header,"Content-Type:");
-	//libcurl also adds the Expect header, removing that header leads to not receiving a response for ages. And there is no rule saying content:!"Expect http_header
+/**
+ * rewrites of pcres before strings are generated from them, each replaces a literal pattern, e.g. character classes that are not supported
+ * by exrex or would produce weird chars. All rewrites are applied in one left to right pass: at every position the first rewrite of the table
+ * whose pattern starts there is applied, escape sequences no rewrite starts with are copied as they are (so \.+ stays an escaped dot).
+ * The output is never scanned again, so the time is linear in the length of the pcre.
+ */
+class pcreRewriteTable {
+	public:
+		class rewrite {
+			public:
+				std::string pattern;
+				std::string replacement;
+				//number of times it was applied, requests are prepared by one thread
+				unsigned long hits=0;
+		};
 
-    for(int j=0;j<rule->body.content.size();j++){
-    	if(rule->body.negatedContent.at(j)){
-    		//skip content because content is negated (and hope it is not generated by accident(or random) before)
-    	}else{
-			switch(rule->body.contentModifierHTTP.at(j)){
-						case 1:{//http_method
-								if(rule->body.content[j]=="GET"){
-									curl_easy_setopt(handle, CURLOPT_HTTPGET, 1L);
-								}else if(rule->body.content[j]=="POST"){
-									curl_easy_setopt(handle, CURLOPT_POST, 1L);
-								//for everything else use the given method string
-								}else{
-									curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, rule->body.content[j].c_str());
-								}
-								break;
-						}
-						case 2://http_uri
-						case 3://http_raw_uri
-								if(rule->body.content[j].find("//")!=std::string::npos){
-									fprintf(stderr,"WARNING: The HTTP uri used for this rule contains multiple slashes. Make sure that your IDS config does not normalize them. sid: %s\n",rule->body.sid.c_str());
-								}
-								{hostUri=hostUri+rule->body.content[j];
-								break;
-						}
-						case 6://header
-						case 7://raw_header
-								{header=curl_slist_append(header, sanitizeHeader(rule->body.content[j],rule->body.sid).c_str());
-								break;
-						}
-						case 4://http_stat_msg
-						case 5:
-								{fprintf(stderr,"Error: Can not control server responses, please remove this rule (sid: %s)\n",rule->body.sid.c_str());
-								if(continueOnError==0){
-									exit(0);
-								}
-								break;
-						}
-						case 8: //client_body. This possibly adds a body also to GET requests, which is not illegal but useless because server is not allowed to interpret it.
-							    //remove \n and \r from string
-								{clientBody=clientBody+(removeCRLF(rule->body.content[j],rule->body.sid));
-								break;
-						}
-						case 9://cookie
-						case 10://raw_cookie
-								{//this way it only copies the value from the rule, meaning it might not always result in a name=value pair.
-								 //this is still legal and accepted by servers.
-									cookies=cookies+rule->body.content[j];
-								break;
-						}
-						default:{
-							fprintf(stderr,"HTTP content modifier unsupported! Aborting\n");
-							exit(0);
-						}
+		/**
+		 * the default table, more specific patterns come before the ones they start with
+		 */
+		pcreRewriteTable(){
+			//whitespace chars become just whitespace and not something like newlines
+			add("\\s"," ");
+			//lazy quantifiers, the .+ and .* rewrites below would leave the ? behind
+			add(".+?","[a-z]");
+			add(".*?","[a-z]");
+			add("+?","+");
+			add("*?","*");
+			//any char becomes an easy to use char and not some weird sh**
+			add(".+","[a-z]");
+			add(".*","[a-z]");
+			add(".?","[a-z]");
+			add("[^&]","[a-z]");
+			add("[^\\]","[a-z]");
+			add("[^\\n]","[a-z]");
+			add("[^\\r\\n]","[a-z]");
+			add("[^\\x2f]","[a-z]");
+		}
 
+		/**
+		 * replaces the table with the rewrites of the given file: one "<pattern><TAB><replacement>" per line, lines starting with # are comments.
+		 * Returns false if the file can not be read or a line has no tab
+		 */
+		bool load(std::string fileName){
+			std::ifstream file(fileName);
+			std::string line;
+			int linenumber=0;
+			if(!file){
+				return false;
 			}
-    	}
-    }
-    for(int k=0;k<rule->body.pcre.size();k++){
-    	if(rule->body.negatedPcre.at(k)==true){
-    		//skip pcre because pcre is negated (and hope it is not generated by accident before)
-    	}else{
-			//we dont have to care about nocasePcre because chars will be generated exactly how given in pcre...
-				std::string pcreString=rule->body.pcre.at(k);
-				//remove newline chars in pcre, fgets only reads one line and in most of our cases they are useless anyway
-				std::string::size_type at=0;
-				std::string crlf="\\r\\n";
-				while (true){
-					at=pcreString.find(crlf,at);
-					if(at!= std::string::npos){
-						//do not remove \r\n if it is negated
-						if(pcreString.at(at-1)!='^'){
-							pcreString.erase(at, crlf.length());
-							fprintf(stderr,"WARNING: Removed \\r\\n in pcre for rule sid:%s\n",rule->body.sid.c_str());
-						}else{
-							at=at+crlf.length();
+			rewrites.clear();
+			for(int i=0;i<256;i++){
+				byFirstChar[i].clear();
+			}
+			while(std::getline(file,line)){
+				linenumber++;
+				if(line.empty()||line[0]=='#'){
+					continue;
+				}
+				std::size_t tab=line.find('\t');
+				if(tab==std::string::npos||tab==0){
+					fprintf(stderr,"Error in pcre rewrite file %s line %d: expected <pattern><TAB><replacement>\n",fileName.c_str(),linenumber);
+					return false;
+				}
+				add(line.substr(0,tab),line.substr(tab+1));
+			}
+			return true;
+		}
+
+		std::string apply(const std::string& pcre, const std::string& sid){
+			std::string result;
+			result.reserve(pcre.size()+16);
+			std::size_t i=0;
+			while(i<pcre.size()){
+				const std::vector<unsigned long>& candidates=byFirstChar[(unsigned char)pcre[i]];
+				bool applied=false;
+				for(unsigned long j=0;j<candidates.size();j++){
+					rewrite* candidate=&rewrites[candidates[j]];
+					if(pcre.compare(i,candidate->pattern.size(),candidate->pattern)==0){
+						result+=candidate->replacement;
+						i+=candidate->pattern.size();
+						candidate->hits++;
+						applied=true;
+						if(verbose){
+							printf("INFO: replaced %s with %s in pcre before generation. sid:%s\n",candidate->pattern.c_str(),candidate->replacement.c_str(),sid.c_str());
 						}
-					}else{
 						break;
 					}
+				}
+				if(applied){
+					continue;
+				}
+				if(pcre[i]=='\\'&&i+1<pcre.size()){
+					result.append(pcre,i,2);
+					i+=2;
+				}else{
+					result+=pcre[i];
+					i++;
+				}
+			}
+			return result;
+		}
+
+		/**
+		 * prints how often every rewrite was applied
+		 */
+		void report(){
+			for(unsigned long i=0;i<rewrites.size();i++){
+				fprintf(stdout,"PCRE rewrite %s -> %s: %lu hits\n",rewrites[i].pattern.c_str(),rewrites[i].replacement.c_str(),rewrites[i].hits);
+			}
+		}
+
+	private:
+		std::vector<rewrite> rewrites;
+		//indices of the rewrites by the first char of their pattern in table order, so only these are tried at a position
+		std::vector<unsigned long> byFirstChar[256];
+
+		void add(std::string pattern, std::string replacement){
+			rewrite entry;
+			entry.pattern=pattern;
+			entry.replacement=replacement;
+			byFirstChar[(unsigned char)pattern[0]].push_back(rewrites.size());
+			rewrites.push_back(entry);
+		}
+};
+
+pcreRewriteTable pcreRewrites;
+
+/**
+ * this function replaces character classes that are not supported by the exrex and problematic chars by equivalent signs, see pcreRewriteTable
+ */
+std::string sanitizePCRE(std::string pcre, std::string sid){
+	return pcreRewrites.apply(pcre,sid);
+}
+/**
+ * node of a parsed pcre, used by the native pcre string generator.
+ * CHARSET nodes generate one char out of chars (a literal is a CHARSET with one char), SEQUENCE and GROUP nodes concatenate their children,
+ * ALTERNATION nodes pick one child, BACKREFERENCE nodes repeat what capturing group number group generated and EMPTY nodes generate nothing (anchors, lookarounds).
+ */
+class pcreNode {
+	public:
+		enum nodeType {CHARSET, SEQUENCE, ALTERNATION, GROUP, BACKREFERENCE, EMPTY};
+		nodeType type=EMPTY;
+		std::string chars;
+		std::vector<pcreNode> children;
+		//capturing group number for GROUP and BACKREFERENCE nodes, 0 means not capturing
+		int group=0;
+		int minRepeat=1;
+		int maxRepeat=1;
+};
+
+/**
+ * generates a random string matching a (sanitized) pcre, in process.
+ * Understands literals, escapes, character classes (also \d,\D,\w,\W,\s,\S,\h,\H,\v,\V,\N,\R and POSIX classes), '.', groups, alternations,
+ * backreferences and all quantifiers (greedy, lazy and possessive are treated the same). Anchors and lookarounds generate nothing.
+ * Wherever a negated class or '.' allows it, letters and digits are generated, so the result is easy to use in an HTTP request.
+ */
+class pcreStringGenerator {
+	public:
+		pcreStringGenerator(unsigned long seed){
+			random.seed(seed);
+		}
+
+		void reseed(uint64_t seed){
+			random.seed((uint32_t)(seed^(seed>>32)));
+		}
+
+		/**
+		 * writes a string matching pcre to result, returns false and sets error if the pcre could not be parsed
+		 */
+		bool generate(std::string pcre, std::string* result){
+			pcreNode root;
+			pattern=pcre;
+			position=0;
+			groupCounter=0;
+			error="";
+			result->clear();
+			if(!parseAlternation(&root)){
+				return false;
+			}
+			if(position<pattern.size()){
+				error="unbalanced closing parenthesis";
+				return false;
+			}
+			captures.assign(groupCounter+1,"");
+			generateNode(root, result);
+			return true;
+		}
+
+		std::string error;
+
+	private:
+		std::string pattern;
+		std::size_t position;
+		int groupCounter;
+		std::vector<std::string> captures;
+		std::mt19937 random;
+
+		/**
+		 * turns a set of allowed chars into the candidate chars of a CHARSET node.
+		 * If preferSafe is set (negated classes, '.'), only letters and digits are used if possible, then unreserved uri chars, then the rest.
+		 * Otherwise printable chars are preferred over non-printable ones.
+		 */
+		std::string charsetCandidates(const std::bitset<256>& set, bool preferSafe){
+			std::string alnum, unreserved, printable, all;
+			for(int c=0;c<256;c++){
+				if(!set.test(c)){
+					continue;
+				}
+				all.push_back((char)c);
+				if(c>=0x20&&c<0x7f){
+					printable.push_back((char)c);
+					if(isalnum(c)){
+						alnum.push_back((char)c);
+					}else if(c=='-'||c=='.'||c=='_'||c=='~'){
+						unreserved.push_back((char)c);
+					}
+				}
+			}
+			if(preferSafe){
+				if(!alnum.empty()){
+					return alnum;
+				}
+				if(!unreserved.empty()){
+					return unreserved;
+				}
+			}
+			if(!printable.empty()){
+				return printable;
+			}
+			return all;
+		}
+
+		/**
+		 * adds the chars of a class escape (\d,\w,...) to set, returns false if c is no class escape
+		 */
+		bool addClassEscape(char c, std::bitset<256>* set){
+			std::bitset<256> temp;
+			bool negate=isupper(c);
+			switch(tolower(c)){
+				case 'd':
+					for(int i='0';i<='9';i++) temp.set(i);
+					break;
+				case 'w':
+					for(int i=0;i<128;i++){
+						if(isalnum(i)||i=='_') temp.set(i);
+					}
+					break;
+				case 's':
+					temp.set(' '); temp.set('\t'); temp.set('\n'); temp.set('\r'); temp.set('\f'); temp.set('\v');
+					break;
+				case 'h':
+					temp.set(' '); temp.set('\t');
+					break;
+				case 'v':
+					temp.set('\n'); temp.set('\r'); temp.set('\f'); temp.set('\v');
+					break;
+				default:
+					return false;
+			}
+			if(negate){
+				//negated classes are only taken from printable ascii
+				for(int i=0x20;i<0x7f;i++){
+					if(!temp.test(i)) set->set(i);
+				}
+			}else{
+				*set|=temp;
+			}
+			return true;
+		}
+
+		/**
+		 * parses hex digits at position, at most maxDigits, or a braced {hhh} form
+		 */
+		int parseHex(int maxDigits){
+			int value=0;
+			int digits=0;
+			bool braced=false;
+			if(position<pattern.size()&&pattern[position]=='{'){
+				braced=true;
+				position++;
+				maxDigits=8;
+			}
+			while(position<pattern.size()&&digits<maxDigits&&isxdigit(pattern[position])){
+				value=value*16+(isdigit(pattern[position])?pattern[position]-'0':tolower(pattern[position])-'a'+10);
+				position++;
+				digits++;
+			}
+			if(braced&&position<pattern.size()&&pattern[position]=='}'){
+				position++;
+			}
+			return value&0xff;
+		}
+
+		/**
+		 * parses a single char escape (position is after the backslash), returns the char.
+		 * Everything that is not a known escape is the escaped char itself.
+		 */
+		char parseCharEscape(){
+			char c=pattern[position++];
+			switch(c){
+				case 'n': return '\n';
+				case 'r': return '\r';
+				case 't': return '\t';
+				case 'f': return '\f';
+				case 'e': return 0x1b;
+				case 'a': return 0x07;
+				case 'x': return (char)parseHex(2);
+				case '0':{
+					int value=0;
+					for(int i=0;i<2&&position<pattern.size()&&pattern[position]>='0'&&pattern[position]<='7';i++){
+						value=value*8+(pattern[position++]-'0');
+					}
+					return (char)value;
+				}
+				default: return c;
+			}
+		}
+
+		/**
+		 * parses alternatives up to a closing parenthesis or the end of the pattern
+		 */
+		bool parseAlternation(pcreNode* node){
+			pcreNode branch;
+			node->type=pcreNode::ALTERNATION;
+			while(true){
+				branch=pcreNode();
+				if(!parseSequence(&branch)){
+					return false;
+				}
+				node->children.push_back(branch);
+				if(position<pattern.size()&&pattern[position]=='|'){
+					position++;
+				}else{
+					break;
+				}
+			}
+			if(node->children.size()==1){
+				pcreNode single=node->children[0];
+				*node=single;
+			}
+			return true;
+		}
+
+		/**
+		 * parses atoms and their quantifiers up to '|', ')' or the end of the pattern
+		 */
+		bool parseSequence(pcreNode* node){
+			node->type=pcreNode::SEQUENCE;
+			while(position<pattern.size()&&pattern[position]!='|'&&pattern[position]!=')'){
+				pcreNode atom;
+				if(!parseAtom(&atom)){
+					return false;
+				}
+				if(!parseQuantifier(&atom)){
+					return false;
+				}
+				node->children.push_back(atom);
+			}
+			return true;
+		}
+
+		/**
+		 * parses an optional quantifier following an atom
+		 */
+		bool parseQuantifier(pcreNode* atom){
+			if(position>=pattern.size()){
+				return true;
+			}
+			char c=pattern[position];
+			if(c=='*'){
+				atom->minRepeat=0;
+				atom->maxRepeat=-1;
+			}else if(c=='+'){
+				atom->minRepeat=1;
+				atom->maxRepeat=-1;
+			}else if(c=='?'){
+				atom->minRepeat=0;
+				atom->maxRepeat=1;
+			}else if(c=='{'){
+				std::size_t end=pattern.find('}',position);
+				std::string bounds;
+				if(end==std::string::npos){
+					//not a quantifier, a literal brace
+					return true;
+				}
+				bounds=pattern.substr(position+1,end-position-1);
+				if(bounds.empty()||bounds.find_first_not_of("0123456789,")!=std::string::npos||bounds[0]==','){
+					return true;
+				}
+				std::size_t comma=bounds.find(',');
+				if(comma==std::string::npos){
+					atom->minRepeat=atoi(bounds.c_str());
+					atom->maxRepeat=atom->minRepeat;
+				}else{
+					atom->minRepeat=atoi(bounds.substr(0,comma).c_str());
+					atom->maxRepeat=(comma==bounds.size()-1)?-1:atoi(bounds.substr(comma+1).c_str());
+					if(atom->maxRepeat!=-1&&atom->maxRepeat<atom->minRepeat){
+						error="quantifier range out of order";
+						return false;
+					}
+				}
+				position=end;
+			}else{
+				return true;
+			}
+			position++;
+			//lazy and possessive quantifiers generate the same strings
+			if(position<pattern.size()&&(pattern[position]=='?'||pattern[position]=='+')){
+				position++;
+			}
+			return true;
+		}
+
+		/**
+		 * parses one atom: a group, a class, '.', an escape or a literal char
+		 */
+		bool parseAtom(pcreNode* node){
+			std::bitset<256> set;
+			char c=pattern[position];
+			switch(c){
+				case '(':
+					return parseGroup(node);
+				case '[':
+					return parseClass(node);
+				case '.':
+					position++;
+					for(int i=0x20;i<0x7f;i++) set.set(i);
+					node->type=pcreNode::CHARSET;
+					node->chars=charsetCandidates(set,true);
+					return true;
+				case '^':
+				case '$':
+					position++;
+					node->type=pcreNode::EMPTY;
+					return true;
+				case '*':
+				case '+':
+				case '?':
+					error="quantifier does not follow a repeatable item";
+					return false;
+				case '\\':
+					return parseEscape(node);
+				default:
+					position++;
+					node->type=pcreNode::CHARSET;
+					node->chars=std::string(1,c);
+					return true;
+			}
+		}
+
+		/**
+		 * parses an escape outside of a class (position is at the backslash)
+		 */
+		bool parseEscape(pcreNode* node){
+			std::bitset<256> set;
+			position++;
+			if(position>=pattern.size()){
+				error="pattern ends with a backslash";
+				return false;
+			}
+			char c=pattern[position];
+			if(addClassEscape(c,&set)){
+				position++;
+				node->type=pcreNode::CHARSET;
+				//a lonely whitespace class becomes a plain whitespace, as sanitizePCRE() does for \s
+				if(c=='s'||c=='h'){
+					node->chars=" ";
+				}else{
+					node->chars=charsetCandidates(set,isupper(c));
+				}
+				return true;
+			}
+			switch(c){
+				case 'N':
+					position++;
+					for(int i=0x20;i<0x7f;i++) set.set(i);
+					node->type=pcreNode::CHARSET;
+					node->chars=charsetCandidates(set,true);
+					return true;
+				case 'R':{
+					//any newline sequence, generate the one HTTP uses
+					pcreNode cr,lf;
+					position++;
+					cr.type=pcreNode::CHARSET;
+					cr.chars="\r";
+					lf.type=pcreNode::CHARSET;
+					lf.chars="\n";
+					node->type=pcreNode::SEQUENCE;
+					node->children.push_back(cr);
+					node->children.push_back(lf);
+					return true;
+				}
+				case 'b': case 'B': case 'A': case 'z': case 'Z': case 'G': case 'K':
+					position++;
+					node->type=pcreNode::EMPTY;
+					return true;
+				case 'Q':{
+					//quoted literal text up to \E
+					std::size_t end=pattern.find("\\E",position+1);
+					std::string quoted=pattern.substr(position+1,end==std::string::npos?std::string::npos:end-position-1);
+					position=(end==std::string::npos)?pattern.size():end+2;
+					node->type=pcreNode::SEQUENCE;
+					for(std::size_t i=0;i<quoted.size();i++){
+						pcreNode literal;
+						literal.type=pcreNode::CHARSET;
+						literal.chars=std::string(1,quoted[i]);
+						node->children.push_back(literal);
+					}
+					return true;
+				}
+				case 'E':
+					position++;
+					node->type=pcreNode::EMPTY;
+					return true;
+				case 'C': case 'X': case 'p': case 'P':
+					error=std::string("unsupported escape \\")+c;
+					return false;
+				default:
+					break;
+			}
+			if(c>='1'&&c<='9'){
+				int group=0;
+				while(position<pattern.size()&&isdigit(pattern[position])){
+					group=group*10+(pattern[position++]-'0');
+				}
+				node->type=pcreNode::BACKREFERENCE;
+				node->group=group;
+				return true;
+			}
+			node->type=pcreNode::CHARSET;
+			node->chars=std::string(1,parseCharEscape());
+			return true;
+		}
+
+		/**
+		 * parses a group (position is at the opening parenthesis)
+		 */
+		bool parseGroup(pcreNode* node){
+			bool capturing=true;
+			bool lookaround=false;
+			position++;
+			if(position<pattern.size()&&pattern[position]=='?'){
+				position++;
+				capturing=false;
+				if(position>=pattern.size()){
+					error="unterminated group";
+					return false;
+				}
+				char c=pattern[position];
+				if(c==':'||c=='>'||c=='|'){
+					position++;
+				}else if(c=='='||c=='!'){
+					position++;
+					lookaround=true;
+				}else if(c=='<'&&position+1<pattern.size()&&(pattern[position+1]=='='||pattern[position+1]=='!')){
+					position+=2;
+					lookaround=true;
+				}else if(c=='<'||c=='\''||c=='P'){
+					//named group, the name itself is not needed
+					std::size_t end=pattern.find_first_of(">'",position+1);
+					if(end==std::string::npos){
+						error="unterminated group name";
+						return false;
+					}
+					position=end+1;
+					capturing=true;
+				}else{
+					//inline option setting like (?i) or (?i:...), options do not change generated strings
+					while(position<pattern.size()&&(isalpha(pattern[position])||pattern[position]=='-')){
+						position++;
+					}
+					if(position<pattern.size()&&pattern[position]==')'){
+						position++;
+						node->type=pcreNode::EMPTY;
+						return true;
+					}
+					if(position<pattern.size()&&pattern[position]==':'){
+						position++;
+					}else{
+						error="unsupported group construct";
+						return false;
+					}
+				}
+			}
+			if(capturing){
+				node->group=++groupCounter;
+			}
+			pcreNode content;
+			if(!parseAlternation(&content)){
+				return false;
+			}
+			if(position>=pattern.size()||pattern[position]!=')'){
+				error="missing closing parenthesis";
+				return false;
+			}
+			position++;
+			if(lookaround){
+				node->type=pcreNode::EMPTY;
+				node->group=0;
+			}else{
+				node->type=pcreNode::GROUP;
+				node->children.push_back(content);
+			}
+			return true;
+		}
+
+		/**
+		 * parses a character class (position is at the opening bracket)
+		 */
+		bool parseClass(pcreNode* node){
+			std::bitset<256> set;
+			bool negated=false;
+			bool first=true;
+			position++;
+			if(position<pattern.size()&&pattern[position]=='^'){
+				negated=true;
+				position++;
+			}
+			while(true){
+				if(position>=pattern.size()){
+					error="missing terminating ] for character class";
+					return false;
+				}
+				char c=pattern[position];
+				if(c==']'&&!first){
+					position++;
+					break;
+				}
+				first=false;
+				int low;
+				if(c=='['&&position+1<pattern.size()&&pattern[position+1]==':'){
+					std::size_t end=pattern.find(":]",position+2);
+					if(end!=std::string::npos){
+						addPosixClass(pattern.substr(position+2,end-position-2),&set);
+						position=end+2;
+						continue;
+					}
+				}
+				if(c=='\\'){
+					position++;
+					if(position>=pattern.size()){
+						error="pattern ends with a backslash";
+						return false;
+					}
+					if(addClassEscape(pattern[position],&set)){
+						position++;
+						continue;
+					}
+					if(pattern[position]=='b'){
+						//backspace inside a class
+						position++;
+						low=0x08;
+					}else{
+						low=(unsigned char)parseCharEscape();
+					}
+				}else{
+					low=(unsigned char)c;
+					position++;
+				}
+				//range?
+				if(position+1<pattern.size()&&pattern[position]=='-'&&pattern[position+1]!=']'){
+					int high;
+					position++;
+					if(pattern[position]=='\\'){
+						position++;
+						high=(unsigned char)parseCharEscape();
+					}else{
+						high=(unsigned char)pattern[position++];
+					}
+					if(high<low){
+						error="range out of order in character class";
+						return false;
+					}
+					for(int i=low;i<=high;i++){
+						set.set(i);
+					}
+				}else{
+					set.set(low);
+				}
+			}
+			if(negated){
+				std::bitset<256> complement;
+				for(int i=0x20;i<0x7f;i++){
+					if(!set.test(i)) complement.set(i);
+				}
+				set=complement;
+			}
+			if(set.none()){
+				error="character class matches nothing";
+				return false;
+			}
+			node->type=pcreNode::CHARSET;
+			node->chars=charsetCandidates(set,negated);
+			return true;
+		}
+
+		/**
+		 * adds the chars of a POSIX class like [:alpha:] to set
+		 */
+		void addPosixClass(std::string name, std::bitset<256>* set){
+			for(int i=0;i<128;i++){
+				if((name=="alpha"&&isalpha(i))||(name=="digit"&&isdigit(i))||(name=="alnum"&&isalnum(i))
+						||(name=="upper"&&isupper(i))||(name=="lower"&&islower(i))||(name=="space"&&isspace(i))
+						||(name=="xdigit"&&isxdigit(i))||(name=="punct"&&ispunct(i))||(name=="print"&&isprint(i))
+						||(name=="graph"&&isgraph(i))||(name=="cntrl"&&iscntrl(i))||(name=="blank"&&(i==' '||i=='\t'))
+						||(name=="word"&&(isalnum(i)||i=='_'))){
+					set->set(i);
+				}
+			}
+		}
+
+		/**
+		 * appends a random string matching node to out
+		 */
+		void generateNode(const pcreNode& node, std::string* out){
+			int maxRepeat=(node.maxRepeat==-1)?node.minRepeat+PCREUNBOUNDEDREPEAT:node.maxRepeat;
+			int repeat=node.minRepeat;
+			if(maxRepeat>node.minRepeat){
+				repeat=std::uniform_int_distribution<int>(node.minRepeat,maxRepeat)(random);
+			}
+			for(int r=0;r<repeat;r++){
+				switch(node.type){
+					case pcreNode::CHARSET:
+						out->push_back(node.chars[std::uniform_int_distribution<std::size_t>(0,node.chars.size()-1)(random)]);
+						break;
+					case pcreNode::SEQUENCE:
+						for(unsigned long i=0;i<node.children.size();i++){
+							generateNode(node.children[i],out);
+						}
+						break;
+					case pcreNode::ALTERNATION:
+						generateNode(node.children[std::uniform_int_distribution<std::size_t>(0,node.children.size()-1)(random)],out);
+						break;
+					case pcreNode::GROUP:{
+						std::size_t start=out->size();
+						generateNode(node.children[0],out);
+						if(node.group>0){
+							captures[node.group]=out->substr(start);
+						}
+						break;
+					}
+					case pcreNode::BACKREFERENCE:
+						if(node.group<(int)captures.size()){
+							out->append(captures[node.group]);
+						}
+						break;
+					case pcreNode::EMPTY:
+						break;
+				}
+			}
+		}
+};
+
+/**
+ * generate string from given pcre (with external command)
+ */
+std::string generateStringFromPCREExternal(std::string pcreString){
+	//pcre payload generation with the help of an external perl script. This script MUST be present in the same folder as this executable file.
+	//this opens a shell and executes above command (or script), if script is not found a line is written and program continues
+    //hardcoded command name. Of course, this command must exist!!!
+    FILE *commandFile;
+	const int BUFSIZE = 1000;
+	char buf[ BUFSIZE ];
+	std::string command="exrex -r ";
+	std::string popenCommand=command+pcreString;
+	if(verbose){
+		printf("INFO: Command for pcre string generation: %s\n",popenCommand.c_str());
+	}
+	commandFile = popen( popenCommand.c_str(), "r" );
+	if ( commandFile == NULL ) {
+		fprintf( stderr, "Could not execute command %s to generate regex payload.\n",popenCommand.c_str() );
+		exit(-1);
+	}
+	//write result to buf
+	while( fgets( buf, BUFSIZE,  commandFile )) {
+		//fprintf( stdout, "%s", buf  );
+	}
+	std::string pcrePayload=buf;
+	pclose( commandFile );
+	return pcrePayload;
+}
+
+/**
+ * lists up to count strings matching the (quoted) pcre with one exrex run instead of one run per string.
+ * exrex lists them in a fixed order, so the same pcre always gives the same strings
+ */
+void generateStringsFromPCREExternal(std::string pcreString, unsigned long count, std::vector<std::string>* payloads){
+    FILE *commandFile;
+	const int BUFSIZE = 1000;
+	char buf[ BUFSIZE ];
+	std::string popenCommand="exrex -m "+std::to_string(count)+" "+pcreString;
+	payloads->clear();
+	if(verbose){
+		printf("INFO: Command for pcre string generation: %s\n",popenCommand.c_str());
+	}
+	commandFile = popen( popenCommand.c_str(), "r" );
+	if ( commandFile == NULL ) {
+		fprintf( stderr, "Could not execute command %s to generate regex payload.\n",popenCommand.c_str() );
+		exit(-1);
+	}
+	//one string per line
+	std::string line;
+	while( fgets( buf, BUFSIZE,  commandFile )) {
+		line+=buf;
+		if(line.back()=='\n'){
+			line.pop_back();
+			payloads->push_back(line);
+			line.clear();
+		}
+	}
+	if(line!=""){
+		payloads->push_back(line);
+	}
+	pclose( commandFile );
+}
+
+/**
+ * 64 bit FNV-1a hash of given data, continuing from hash
+ */
+uint64_t hashBytes(const char* data, std::size_t length, uint64_t hash=14695981039346656037ULL){
+	for(std::size_t i=0;i<length;i++){
+		hash^=(unsigned char)data[i];
+		hash*=1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+ * persistent cache of generated pcre payloads.
+ * Entries are keyed by a hash of generator, generator version, seed and sanitized pattern. The file starts with PCRECACHEMAGIC,
+ * followed by records of 8 byte key, 4 byte payload length and the payload. It is loaded at startup, new entries are appended at the end of the run.
+ */
+class pcrePayloadCache {
+	public:
+		unsigned long hits=0;
+		unsigned long misses=0;
+
+		/**
+		 * reads all entries of the given cache file, a missing file is an empty cache
+		 */
+		void load(std::string cacheFileName){
+			char magic[sizeof(PCRECACHEMAGIC)-1];
+			uint64_t key;
+			uint32_t length;
+			std::string payload;
+			fileName=cacheFileName;
+			std::ifstream file(fileName.c_str(), std::ios::binary);
+			fileExists=file.is_open();
+			if(!fileExists){
+				return;
+			}
+			if(!file.read(magic,sizeof(magic))||std::string(magic,sizeof(magic))!=PCRECACHEMAGIC){
+				fprintf(stderr,"WARNING: %s is no pcre payload cache, it is not used\n",fileName.c_str());
+				fileName="";
+				return;
+			}
+			while(file.read((char*)&key,sizeof(key))&&file.read((char*)&length,sizeof(length))){
+				payload.resize(length);
+				if(length>0&&!file.read(&payload[0],length)){
+					fprintf(stderr,"WARNING: pcre payload cache %s is truncated, ignoring last entry\n",fileName.c_str());
+					break;
+				}
+				entries[key]=payload;
+			}
+		}
+
+		bool lookup(uint64_t key, std::string* payload){
+			std::unordered_map<uint64_t,std::string>::const_iterator entry=entries.find(key);
+			if(entry==entries.end()){
+				misses++;
+				return false;
+			}
+			hits++;
+			*payload=entry->second;
+			return true;
+		}
+
+		void insert(uint64_t key, std::string payload){
+			if(entries.insert(std::make_pair(key,payload)).second){
+				newKeys.push_back(key);
+			}
+		}
+
+		/**
+		 * appends all entries added since load() to the cache file
+		 */
+		void save(){
+			if(fileName==""||newKeys.empty()){
+				return;
+			}
+			std::ofstream file(fileName.c_str(), std::ios::binary|std::ios::app);
+			if(!file.is_open()){
+				fprintf(stderr,"WARNING: could not write pcre payload cache %s\n",fileName.c_str());
+				return;
+			}
+			if(!fileExists){
+				file.write(PCRECACHEMAGIC,sizeof(PCRECACHEMAGIC)-1);
+			}
+			for(unsigned long i=0;i<newKeys.size();i++){
+				const std::string& payload=entries[newKeys[i]];
+				uint32_t length=payload.size();
+				file.write((const char*)&newKeys[i],sizeof(newKeys[i]));
+				file.write((const char*)&length,sizeof(length));
+				file.write(payload.data(),length);
+			}
+			fileExists=true;
+			newKeys.clear();
+		}
+
+	private:
+		std::string fileName;
+		bool fileExists=false;
+		std::unordered_map<uint64_t,std::string> entries;
+		std::vector<uint64_t> newKeys;
+};
+
+pcrePayloadCache* payloadCache=NULL;
+
+/**
+ * one rule line of the rule index (--sids, --msg, --modifier): where the line is and what a selection looks at without parsing the rule
+ */
+class ruleIndexEntry {
+	public:
+		uint64_t offset=0;
+		uint32_t length=0;
+		uint32_t linenumber=0;
+		//bit (1<<httpModifier) for every http modifier keyword and pcre modifier in the line, the parsed rule may use fewer
+		uint16_t modifierMask=0;
+		std::string sid;
+		std::string rev;
+		std::string msg;
+};
+
+/**
+ * scans the rule file for the sid, rev, msg and modifiers of every rule line. Only splits the lines into their options, nothing is parsed.
+ * Comments and lines without sid are left out, parsing them would not give a rule anyway
+ */
+void buildRuleIndex(std::string_view contents, std::vector<ruleIndexEntry>* entries){
+	std::vector<ruleOption> options;
+	std::size_t position=0;
+	uint32_t linenumber=0;
+	entries->clear();
+	while(position<contents.size()){
+		std::size_t end=contents.find('\n',position);
+		if(end==std::string_view::npos){
+			end=contents.size();
+		}
+		std::string_view line=contents.substr(position,end-position);
+		linenumber++;
+		if(line.substr(0,1)!="#"&&tokenizeRuleBody(line,&options)){
+			ruleIndexEntry entry;
+			for(unsigned long i=0;i<options.size();i++){
+				const ruleOption& option=options[i];
+				if(option.keyword=="sid"){
+					entry.sid=option.value;
+				}else if(option.keyword=="rev"&&entry.rev==""){
+					entry.rev=option.value;
+				}else if(option.keyword=="msg"&&option.value.size()>=2){
+					entry.msg=option.value.substr(1,option.value.size()-2);
+				}else if(option.keyword=="uricontent"){
+					entry.modifierMask|=1<<HTTP_URI;
+				}else if(option.keyword=="pcre"){
+					std::size_t slash=option.value.find_last_of('/');
+					for(std::size_t j=slash==std::string_view::npos?option.value.size():slash+1;j<option.value.size();j++){
+						httpModifier modifier=pcreModifier(option.value[j]);
+						if(modifier!=HTTP_NONE){
+							entry.modifierMask|=1<<modifier;
+						}
+					}
+				}else{
+					for(int modifier=HTTP_NONE+1;modifier<HTTP_MODIFIERCOUNT;modifier++){
+						if(option.keyword==httpModifierNames[modifier]){
+							entry.modifierMask|=1<<modifier;
+						}
+					}
+				}
+			}
+			if(entry.sid!=""){
+				entry.offset=position;
+				entry.length=line.size();
+				entry.linenumber=linenumber;
+				entries->push_back(std::move(entry));
+			}
+		}
+		position=end+1;
+	}
+}
+
+/**
+ * which rules to parse and send (--sids, --msg, --modifier), all given criteria have to match
+ */
+class ruleSelection {
+	public:
+		//msg has to contain this
+		std::string msg;
+		//at least one content or pcre has one of these modifiers, 0 for any
+		uint16_t modifierMask=0;
+
+		bool active(){
+			return sidsSet||msg!=""||modifierMask!=0;
+		}
+
+		/**
+		 * adds sids and sid ranges, comma or whitespace separated: 2001,2005,3000-3999. @<file> reads them from a file.
+		 * Returns false if the list is malformed
+		 */
+		bool addSids(std::string spec){
+			std::string token;
+			unsigned long first,last;
+			char tail;
+			if(spec.substr(0,1)=="@"){
+				std::ifstream file(spec.substr(1).c_str());
+				if(!file.is_open()){
+					return false;
+				}
+				spec.assign(std::istreambuf_iterator<char>(file),std::istreambuf_iterator<char>());
+			}
+			std::replace(spec.begin(),spec.end(),',',' ');
+			std::istringstream tokens(spec);
+			sidsSet=true;
+			while(tokens>>token){
+				if(sscanf(token.c_str(),"%lu-%lu%c",&first,&last,&tail)==2&&first<=last){
+					sidRanges.push_back(std::make_pair(first,last));
+				}else if(sscanf(token.c_str(),"%lu%c",&first,&tail)==1){
+					sids.insert(first);
+				}else{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/**
+		 * true if the indexed rule may be selected, the modifiers are only known for sure after parsing
+		 */
+		bool matches(const ruleIndexEntry& entry){
+			return sidMatches(entry.sid)&&(msg==""||entry.msg.find(msg)!=std::string::npos)&&(modifierMask==0||(entry.modifierMask&modifierMask)!=0);
+		}
+
+		/**
+		 * true if the parsed rule is selected
+		 */
+		bool matches(const snortRule& rule){
+			if(!sidMatches(rule.body.sid)||(msg!=""&&rule.body.msg.find(msg)==std::string::npos)){
+				return false;
+			}
+			if(modifierMask==0){
+				return true;
+			}
+			for(unsigned long i=0;i<rule.body.matches.size();i++){
+				if((modifierMask&(1<<rule.body.matches[i].modifier))!=0){
+					return true;
+				}
+			}
+			return false;
+		}
+
+	private:
+		bool sidsSet=false;
+		std::unordered_set<unsigned long> sids;
+		std::vector<std::pair<unsigned long,unsigned long> > sidRanges;
+
+		bool sidMatches(const std::string& sidString){
+			char* end;
+			unsigned long sid;
+			if(!sidsSet){
+				return true;
+			}
+			sid=strtoul(sidString.c_str(),&end,10);
+			if(sidString==""||*end!='\0'){
+				return false;
+			}
+			if(sids.count(sid)>0){
+				return true;
+			}
+			for(unsigned long i=0;i<sidRanges.size();i++){
+				if(sid>=sidRanges[i].first&&sid<=sidRanges[i].second){
+					return true;
+				}
+			}
+			return false;
+		}
+};
+
+/**
+ * binary cache of the parsed rules of one rule file, so an unchanged rule file does not have to be parsed again.
+ * The file starts with RULECACHEMAGIC and an 8 byte key, a hash of parser version, parse flags and the whole rule file, followed by
+ * the number of rules, the rules and the counters of the rule line statistics. Strings are stored as 4 byte length and bytes,
+ * flags and http modifiers as one byte each.
+ * The rule index is stored the same way, starting with RULEINDEXMAGIC and a key without parse flags.
+ */
+class compiledRuleCache {
+	public:
+		/**
+		 * key of the given rule file contents, also covers everything else that changes the parse result
+		 */
+		static uint64_t key(std::string_view ruleFileContents){
+			char keyPrefix[64];
+			snprintf(keyPrefix,sizeof(keyPrefix),"%d/%d/%d/",RULEPARSERVERSION,continueOnError?1:0,responseRules?1:0);
+			return hashContents(keyPrefix,ruleFileContents);
+		}
+
+		/**
+		 * key of the rule index of the given rule file contents, the index does not depend on any option
+		 */
+		static uint64_t indexKey(std::string_view ruleFileContents){
+			char keyPrefix[64];
+			snprintf(keyPrefix,sizeof(keyPrefix),"index/%d/",RULEINDEXVERSION);
+			return hashContents(keyPrefix,ruleFileContents);
+		}
+
+		/**
+		 * reads the rules from the given cache file into rules and the line counts of the parse into statistics, only if it was written for the given key.
+		 * Returns false if the file is missing, stale or broken, rules is empty and statistics unchanged then.
+		 */
+		static bool load(std::string fileName, uint64_t expectedKey, std::vector<snortRule>* rules, ruleLineStatistics* statistics){
+			mappedFile cacheFile;
+			uint64_t fileKey;
+			uint64_t count;
+			std::vector<uint64_t> counts;
+			rules->clear();
+			if(!cacheFile.open(fileName)){
+				return false;
+			}
+			reader in(cacheFile.data());
+			if(in.data.substr(0,sizeof(RULECACHEMAGIC)-1)!=RULECACHEMAGIC){
+				return false;
+			}
+			in.position=sizeof(RULECACHEMAGIC)-1;
+			if(!in.read(&fileKey)||fileKey!=expectedKey||!in.read(&count)){
+				return false;
+			}
+			if(!in.holds(count,RULECACHEMINRECORD)){
+				fprintf(stderr,"WARNING: rule cache %s is broken, parsing rule file\n",fileName.c_str());
+				return false;
+			}
+			rules->resize(count);
+			for(uint64_t i=0;i<count;i++){
+				if(!readRule(&in,&rules->at(i))){
+					fprintf(stderr,"WARNING: rule cache %s is broken, parsing rule file\n",fileName.c_str());
+					rules->clear();
+					return false;
+				}
+			}
+			if(!in.read(&counts)||!statistics->setCounts(counts)){
+				fprintf(stderr,"WARNING: rule cache %s is broken, parsing rule file\n",fileName.c_str());
+				rules->clear();
+				return false;
+			}
+			return true;
+		}
+
+		/**
+		 * writes the rules and the line counts of their parse to the given cache file
+		 */
+		static void save(std::string fileName, uint64_t key, std::vector<snortRule>* rules, ruleLineStatistics* statistics){
+			std::string out(RULECACHEMAGIC);
+			uint64_t count=rules->size();
+			append(&out,key);
+			append(&out,count);
+			for(unsigned long i=0;i<rules->size();i++){
+				writeRule(&out,&rules->at(i));
+			}
+			append(&out,statistics->counts());
+			if(!replaceFile(fileName,out)){
+				fprintf(stderr,"WARNING: could not write rule cache %s\n",fileName.c_str());
+			}
+		}
+
+		/**
+		 * reads the rule index from the given file, only if it was written for the given key. Returns false if it is missing, stale or broken
+		 */
+		static bool loadIndex(std::string fileName, uint64_t expectedKey, std::vector<ruleIndexEntry>* entries){
+			mappedFile indexFile;
+			uint64_t fileKey;
+			uint64_t count;
+			entries->clear();
+			if(!indexFile.open(fileName)){
+				return false;
+			}
+			reader in(indexFile.data());
+			if(in.data.substr(0,sizeof(RULEINDEXMAGIC)-1)!=RULEINDEXMAGIC){
+				return false;
+			}
+			in.position=sizeof(RULEINDEXMAGIC)-1;
+			if(!in.read(&fileKey)||fileKey!=expectedKey||!in.read(&count)){
+				return false;
+			}
+			if(!in.holds(count,RULEINDEXMINRECORD)){
+				fprintf(stderr,"WARNING: rule index %s is broken, scanning rule file\n",fileName.c_str());
+				return false;
+			}
+			entries->resize(count);
+			for(uint64_t i=0;i<count;i++){
+				ruleIndexEntry* entry=&entries->at(i);
+				if(!in.read(&entry->offset)||!in.read(&entry->length)||!in.read(&entry->linenumber)||!in.read(&entry->modifierMask)||
+						!in.read(&entry->sid)||!in.read(&entry->rev)||!in.read(&entry->msg)){
+					fprintf(stderr,"WARNING: rule index %s is broken, scanning rule file\n",fileName.c_str());
+					entries->clear();
+					return false;
+				}
+			}
+			return true;
+		}
+
+		static void saveIndex(std::string fileName, uint64_t key, std::vector<ruleIndexEntry>* entries){
+			std::string out(RULEINDEXMAGIC);
+			uint64_t count=entries->size();
+			append(&out,key);
+			append(&out,count);
+			for(unsigned long i=0;i<entries->size();i++){
+				const ruleIndexEntry& entry=entries->at(i);
+				append(&out,entry.offset);
+				append(&out,entry.length);
+				append(&out,entry.linenumber);
+				append(&out,entry.modifierMask);
+				append(&out,entry.sid);
+				append(&out,entry.rev);
+				append(&out,entry.msg);
+			}
+			if(!replaceFile(fileName,out)){
+				fprintf(stderr,"WARNING: could not write rule index %s\n",fileName.c_str());
+			}
+		}
+
+	private:
+		static uint64_t hashContents(const char* keyPrefix, std::string_view ruleFileContents){
+			uint64_t hash=hashBytes(keyPrefix,strlen(keyPrefix));
+			uint64_t word;
+			std::size_t i=0;
+			//rule files can be hundreds of MB, so FNV-1a runs over 8 byte words here and only the tail byte wise
+			for(;i+sizeof(word)<=ruleFileContents.size();i+=sizeof(word)){
+				memcpy(&word,ruleFileContents.data()+i,sizeof(word));
+				hash^=word;
+				hash*=1099511628211ULL;
+			}
+			return hashBytes(ruleFileContents.data()+i,ruleFileContents.size()-i,hash);
+		}
+
+		/**
+		 * the file is replaced at once, so a concurrent run never sees half of it
+		 */
+		static bool replaceFile(std::string fileName, const std::string& contents){
+			std::string tempFileName=fileName+".tmp";
+			std::ofstream file(tempFileName.c_str(), std::ios::binary|std::ios::trunc);
+			if(!file.is_open()||!file.write(contents.data(),contents.size())){
+				return false;
+			}
+			file.close();
+			if(rename(tempFileName.c_str(),fileName.c_str())!=0){
+				remove(tempFileName.c_str());
+				return false;
+			}
+			return true;
+		}
+
+		class reader {
+			public:
+				std::string_view data;
+				std::size_t position=0;
+
+				reader(std::string_view cacheData):data(cacheData){}
+
+				/**
+				 * true if the rest of the data is large enough for count records of at least recordSize bytes
+				 */
+				bool holds(uint64_t count, std::size_t recordSize){
+					return count<=(data.size()-position)/recordSize;
+				}
+
+				template<typename T> bool read(T* value){
+					if(data.size()-position<sizeof(T)){
+						return false;
+					}
+					memcpy(value,data.data()+position,sizeof(T));
+					position+=sizeof(T);
+					return true;
+				}
+
+				bool read(std::string* value){
+					uint32_t length;
+					if(!read(&length)||data.size()-position<length){
+						return false;
+					}
+					value->assign(data.data()+position,length);
+					position+=length;
+					return true;
+				}
+
+				bool read(ruleMatch* match){
+					return read(&match->pattern)&&read(&match->modifier)&&read(&match->flags)&&match->modifier<HTTP_MODIFIERCOUNT;
+				}
+
+				bool read(bool* value){
+					uint8_t flag;
+					if(!read(&flag)){
+						return false;
+					}
+					*value=flag!=0;
+					return true;
+				}
+
+				template<typename T> bool read(std::vector<T>* values){
+					uint32_t count;
+					T value;
+					if(!read(&count)||count>data.size()-position){
+						return false;
+					}
+					values->clear();
+					values->reserve(count);
+					for(uint32_t i=0;i<count;i++){
+						if(!read(&value)){
+							return false;
+						}
+						values->push_back(value);
+					}
+					return true;
+				}
+		};
+
+		template<typename T> static void append(std::string* out, T value){
+			out->append((const char*)&value,sizeof(T));
+		}
+
+		static void append(std::string* out, const std::string& value){
+			append(out,(uint32_t)value.size());
+			out->append(value);
+		}
+
+		static void append(std::string* out, const ruleMatch& match){
+			append(out,match.pattern);
+			append(out,match.modifier);
+			append(out,match.flags);
+		}
+
+		static void append(std::string* out, bool value){
+			append(out,(uint8_t)(value?1:0));
+		}
+
+		template<typename T> static void append(std::string* out, const std::vector<T>& values){
+			append(out,(uint32_t)values.size());
+			for(unsigned long i=0;i<values.size();i++){
+				append(out,values[i]);
+			}
+		}
+
+		static void writeRule(std::string* out, snortRule* rule){
+			append(out,rule->header.action);
+			append(out,rule->header.protocol);
+			append(out,rule->header.from);
+			append(out,rule->header.fromPort);
+			append(out,rule->header.bidirectional);
+			append(out,rule->header.to);
+			append(out,rule->header.toPort);
+			append(out,rule->body.msg);
+			append(out,rule->body.matches);
+			append(out,rule->body.sid);
+			append(out,rule->body.rev);
+		}
+
+		static bool readRule(reader* in, snortRule* rule){
+			return in->read(&rule->header.action)&&in->read(&rule->header.protocol)&&in->read(&rule->header.from)&&
+					in->read(&rule->header.fromPort)&&in->read(&rule->header.bidirectional)&&in->read(&rule->header.to)&&
+					in->read(&rule->header.toPort)&&in->read(&rule->body.msg)&&in->read(&rule->body.matches)&&
+					in->read(&rule->body.sid)&&in->read(&rule->body.rev);
+		}
+};
+
+//a new round generates new pcre payloads, e.g. for every iteration of a soak run with --regenerate
+unsigned long pcreRound=0;
+
+/**
+ * generate string from given (sanitized) pcre with the configured generator, or take it from the payload cache.
+ * The native generator is seeded from the seed, the round and the pcre, so a pcre gets the same payload no matter which pcres came before
+ */
+std::string generateStringFromPCRE(std::string pcreString, std::string sid){
+	std::string pcrePayload;
+	uint64_t cacheKey;
+	char keyPrefix[64];
+	snprintf(keyPrefix,sizeof(keyPrefix),"%s/%d/%lu/",externalPcreGenerator?"exrex":"native",PCREGENERATORVERSION,pcreSeed);
+	cacheKey=hashBytes(keyPrefix,strlen(keyPrefix));
+	cacheKey=hashBytes(pcreString.data(),pcreString.size(),cacheKey);
+	if(payloadCache!=NULL&&payloadCache->lookup(cacheKey,&pcrePayload)){
+		return pcrePayload;
+	}
+	if(externalPcreGenerator){
+		//quote it, if not shell will expand this to nasty stuff
+		pcrePayload=generateStringFromPCREExternal("\""+pcreString+"\"");
+	}else{
+		static pcreStringGenerator generator(0);
+		//the cache is bypassed in later rounds, so the key only has to cover the first one
+		generator.reseed(pcreRound==0?cacheKey:hashBytes((const char*)&pcreRound,sizeof(pcreRound),cacheKey));
+		if(!generator.generate(pcreString,&pcrePayload)){
+			fprintf(stderr,"WARNING: native pcre generator failed for pcre:%s (%s), rule sid:%s\n",pcreString.c_str(),generator.error.c_str(),sid.c_str());
+		}
+	}
+	//failed generations are not remembered
+	if(payloadCache!=NULL&&pcrePayload!=""){
+		payloadCache->insert(cacheKey,pcrePayload);
+	}
+	return pcrePayload;
+}
+
+//payload variants of every pcre of the current round, see generatePcreVariant()
+std::unordered_map<std::string,std::vector<std::string> > pcreVariants;
+
+/**
+ * generates up to payloadVariants distinct strings matching pcreString at once: exrex lists them in one run, the native generator is
+ * seeded from the seed, the round and the pcre, so the variants of a pcre do not depend on which rules were prepared before.
+ */
+void generatePcreVariants(std::string pcreString, std::string sid, std::vector<std::string>* variants){
+	std::vector<std::string> candidates;
+	std::unordered_set<std::string> seen;
+	char keyPrefix[96];
+	uint64_t cacheKey;
+	std::string payload;
+	variants->clear();
+	snprintf(keyPrefix,sizeof(keyPrefix),"%s/%d/%lu/variants/%lu/%lu/",externalPcreGenerator?"exrex":"native",PCREGENERATORVERSION,pcreSeed,payloadVariants,pcreRound);
+	cacheKey=hashBytes(keyPrefix,strlen(keyPrefix));
+	cacheKey=hashBytes(pcreString.data(),pcreString.size(),cacheKey);
+	//variants never contain newlines, so the cache keeps them as one payload with one variant per line
+	if(payloadCache!=NULL&&payloadCache->lookup(cacheKey,&payload)){
+		std::size_t start=0;
+		std::size_t end;
+		while((end=payload.find('\n',start))!=std::string::npos){
+			variants->push_back(payload.substr(start,end-start));
+			start=end+1;
+		}
+		variants->push_back(payload.substr(start));
+		return;
+	}
+	//newlines are removed from payloads anyway, variants that only differ in them are the same
+	auto addVariant=[&](std::string candidate){
+		candidate.erase(std::remove(candidate.begin(),candidate.end(),'\n'),candidate.end());
+		candidate.erase(std::remove(candidate.begin(),candidate.end(),'\r'),candidate.end());
+		if(variants->size()<payloadVariants&&seen.insert(candidate).second){
+			variants->push_back(candidate);
+		}
+	};
+	if(externalPcreGenerator){
+		//quote it, if not shell will expand this to nasty stuff
+		generateStringsFromPCREExternal("\""+pcreString+"\"",payloadVariants,&candidates);
+		for(unsigned long i=0;i<candidates.size();i++){
+			addVariant(candidates[i]);
+		}
+	}else{
+		static pcreStringGenerator generator(0);
+		generator.reseed(cacheKey);
+		//pcres that match only a few strings give up after some attempts
+		for(unsigned long i=0;i<payloadVariants*PCREVARIANTATTEMPTS&&variants->size()<payloadVariants;i++){
+			if(!generator.generate(pcreString,&payload)){
+				fprintf(stderr,"WARNING: native pcre generator failed for pcre:%s (%s), rule sid:%s\n",pcreString.c_str(),generator.error.c_str(),sid.c_str());
+				break;
+			}
+			addVariant(payload);
+		}
+	}
+	if(verbose&&variants->size()<payloadVariants){
+		printf("INFO: only %lu distinct payloads found for pcre:%s, rule sid:%s\n",(unsigned long)variants->size(),pcreString.c_str(),sid.c_str());
+	}
+	if(payloadCache!=NULL&&!variants->empty()){
+		payload.clear();
+		for(unsigned long i=0;i<variants->size();i++){
+			payload+=(i==0?"":"\n")+variants->at(i);
+		}
+		payloadCache->insert(cacheKey,payload);
+	}
+}
+
+/**
+ * returns variant number variant of the distinct strings matching pcreString, variants are generated once per pcre and round.
+ * variantCount is set to the number of distinct variants, fewer than payloadVariants if the pcre does not match that many strings
+ */
+std::string generatePcreVariant(std::string pcreString, std::string sid, unsigned long variant, unsigned long* variantCount){
+	std::vector<std::string>& variants=pcreVariants[pcreString];
+	if(variants.empty()){
+		generatePcreVariants(pcreString,sid,&variants);
+	}
+	*variantCount=std::max((std::size_t)1,variants.size());
+	if(variants.empty()){
+		return "";
+	}
+	return variants[variant%variants.size()];
+}
+
+/**
+ * pool of reusable curl easy handles.
+ * Handles are reset when given back, so no cookie or header of the last rule is sent again (this is why every request used
+ * a fresh handle before). All handles use one share for DNS cache and connections, but NOT for cookies,
+ * so keep-alive connections and name resolution survive over the whole run.
+ */
+class curlHandlePool {
+	public:
+		curlHandlePool(){
+			share=curl_share_init();
+			curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+			curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+			curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+		}
+		~curlHandlePool(){
+			for(unsigned long i=0;i<idleHandles.size();i++){
+				curl_easy_cleanup(idleHandles[i]);
+			}
+			curl_share_cleanup(share);
+		}
+		/**
+		 * returns a handle without any options set except the share
+		 */
+		CURL* acquire(){
+			CURL *handle;
+			if(idleHandles.empty()){
+				handle=curl_easy_init();
+				if(handle==NULL){
+					fprintf(stderr,"Could not initialize curl handle. Aborting!\n");
+					exit(1);
+				}
+				curl_easy_setopt(handle, CURLOPT_SHARE, share);
+			}else{
+				handle=idleHandles.back();
+				idleHandles.pop_back();
+			}
+			return handle;
+		}
+		/**
+		 * takes back a handle that is not used by any transfer anymore
+		 */
+		void release(CURL* handle){
+			//reset everything, necessary because curl remembers last cookie and sends it again
+			curl_easy_reset(handle);
+			curl_easy_setopt(handle, CURLOPT_SHARE, share);
+			idleHandles.push_back(handle);
+		}
+	private:
+		CURLSH *share;
+		std::vector<CURL*> idleHandles;
+};
+
+/**
+ * splits an http url into the authority (host and port) and the request target, returns false for other schemes
+ */
+bool splitHttpUrl(std::string url, std::string* authority, std::string* target){
+	std::size_t schemeEnd=url.find("://");
+	std::size_t authorityEnd;
+	if(schemeEnd!=std::string::npos){
+		if(url.compare(0,schemeEnd,"http")!=0){
+			return false;
+		}
+		url.erase(0,schemeEnd+3);
+	}
+	authorityEnd=url.find('/');
+	if(authorityEnd==std::string::npos){
+		*authority=url;
+		*target="/";
+	}else{
+		*authority=url.substr(0,authorityEnd);
+		*target=url.substr(authorityEnd);
+	}
+	return *authority!="";
+}
+
+/**
+ * writes the request exactly as the raw backend sends it into request->raw.
+ * Headers libcurl only needs to suppress its own defaults (name with a colon and nothing else) are left out, nothing else is changed.
+ */
+void serializeRawRequest(preparedRequest* request){
+	std::string authority;
+	std::string target;
+	std::string& raw=request->raw;
+	if(!splitHttpUrl(request->url,&authority,&target)){
+		fprintf(stderr,"Error: the raw backend only supports http urls: %s\n",request->url.c_str());
+		exit(1);
+	}
+	raw.clear();
+	switch(request->method){
+		case preparedRequest::GET:
+			raw+="GET";
+			break;
+		case preparedRequest::POST:
+			raw+="POST";
+			break;
+		case preparedRequest::CUSTOM:
+			raw+=request->customMethod;
+			break;
+	}
+	raw+=" "+target+" HTTP/1.1\r\nHost: "+authority+"\r\n";
+	for(struct curl_slist* item=request->header.get();item!=NULL;item=item->next){
+		std::size_t length=strlen(item->data);
+		if(length>0&&item->data[length-1]==':'){
+			continue;
+		}
+		raw.append(item->data,length);
+		raw+="\r\n";
+	}
+	if(request->cookies!=""){
+		raw+="Cookie: "+request->cookies+"\r\n";
+	}
+	if(request->hasClientBody||request->method==preparedRequest::POST){
+		raw+="Content-Length: "+std::to_string(request->hasClientBody?request->clientBody.size():0)+"\r\n\r\n";
+		if(request->hasClientBody){
+			raw+=request->clientBody;
+		}
+	}else{
+		raw+="\r\n";
+	}
+}
+
+/**
+ * reason phrase of common status codes, for responses to rules without http_stat_msg
+ */
+const char* httpReasonPhrase(int code){
+	switch(code){
+		case 200: return "OK";
+		case 201: return "Created";
+		case 204: return "No Content";
+		case 301: return "Moved Permanently";
+		case 302: return "Found";
+		case 304: return "Not Modified";
+		case 400: return "Bad Request";
+		case 401: return "Unauthorized";
+		case 403: return "Forbidden";
+		case 404: return "Not Found";
+		case 405: return "Method Not Allowed";
+		case 500: return "Internal Server Error";
+		case 502: return "Bad Gateway";
+		case 503: return "Service Unavailable";
+		default: return "Status";
+	}
+}
+
+/**
+ * adds the value of a http_stat_code or http_stat_msg content or pcre to the response the request expects.
+ * Snort matches status code contents anywhere in the code, so prefixes like "40" are filled up with zeros.
+ */
+void setExpectedStatus(preparedRequest* request, httpModifier modifier, std::string value, std::string sid){
+	if(modifier==HTTP_STAT_MSG){
+		request->statusMessage+=removeCRLF(value,sid);
+		return;
+	}
+	if(value.empty()||value.size()>3||value.find_first_not_of("0123456789")!=std::string::npos){
+		fprintf(stderr,"WARNING: http_stat_code %s is not a status code, the responder answers with the default status. sid:%s\n",value.c_str(),sid.c_str());
+		return;
+	}
+	value.append(3-value.size(),'0');
+	int code=atoi(value.c_str());
+	//a 1xx response is followed by the real one, clients would wait for it
+	if(code<200||code>599){
+		fprintf(stderr,"WARNING: only status codes 200-599 can be responded, the responder answers %d with the default status. sid:%s\n",code,sid.c_str());
+		return;
+	}
+	request->statusCode=code;
+}
+
+/**
+ * the response the rule of the given request expects, as the built-in responder and the pcap export send it. It never has a body.
+ */
+std::string expectedResponse(const preparedRequest* request){
+	int code=request->statusCode!=0?request->statusCode:200;
+	std::string reason=request->statusMessage!=""?request->statusMessage:httpReasonPhrase(code);
+	return "HTTP/1.1 "+std::to_string(code)+" "+reason+"\r\nContent-Length: 0\r\n\r\n";
+}
+
+/**
+ * builds the HTTP request to the given host containing the pattern(s) of the given rule, pcre payloads are generated here.
+ * With --variants the pcres get the payloads of the given variant, returns the number of distinct variants of the rule (1 without pcres).
+ * Returns 0 if the rule can not be sent, the error is printed then
+ */
+unsigned long prepareRulePacket(snortRule* rule, std::string host, preparedRequest* request, unsigned long variant=0){
+    std::string hostUri="";
+    std::string cookies="";
+    //we generally add 6 chars to the client body because
+    //Snort does not do any pattern matching if there are less than 6 chars
+    std::string clientBody="12345";
+	//list for custom headers, here we put the sid number to correlate the request with a rule and additional http_header fields
+	struct curl_slist *header=NULL;
+	std::string pcrePayload;
+	unsigned long variants=1;
+
+	//http GET is the default method, will be changed in case
+	request->method=preparedRequest::GET;
+	request->statusCode=0;
+	request->statusMessage="";
+	//remove Accept: */* header which libcurl sets by default
+	header=curl_slist_append(header,"Accept:");
+	//remove Content-Type header which libcurl sets by default for POST request, and which makes good sense but is not mandatory. It can still be added by a rule later on.
+	header=curl_slist_append(header,"Content-Type:");
+	//libcurl also adds the Expect header, removing that header leads to not receiving a response for ages. And there is no rule saying content:!"Expect http_header
+
+    //contents come first, so pcre payloads are appended after them as before
+    for(unsigned long j=0;j<rule->body.matches.size();j++){
+    	const ruleMatch* match=&rule->body.matches[j];
+    	if(match->has(ruleMatch::NEGATED)){
+    		//skip content or pcre because it is negated (and hope it is not generated by accident(or random) before)
+    	}else if(!match->has(ruleMatch::PCRE)){
+			switch(match->modifier){
+						case HTTP_METHOD:{//http_method
+								if(match->pattern=="GET"){
+									request->method=preparedRequest::GET;
+								}else if(match->pattern=="POST"){
+									request->method=preparedRequest::POST;
+								//for everything else use the given method string
+								}else{
+									request->method=preparedRequest::CUSTOM;
+									request->customMethod=match->pattern;
+								}
+								break;
+						}
+						case HTTP_URI://http_uri
+						case HTTP_RAW_URI://http_raw_uri
+								if(match->pattern.find("//")!=std::string::npos){
+									fprintf(stderr,"WARNING: The HTTP uri used for this rule contains multiple slashes. Make sure that your IDS config does not normalize them. sid: %s\n",rule->body.sid.c_str());
+								}
+								{hostUri=hostUri+match->pattern;
+								break;
+						}
+						case HTTP_HEADER://header
+						case HTTP_RAW_HEADER://raw_header
+								{header=curl_slist_append(header, sanitizeHeader(match->pattern,rule->body.sid).c_str());
+								break;
+						}
+						case HTTP_STAT_MSG://http_stat_msg
+						case HTTP_STAT_CODE:
+								{if(responseRules){
+									setExpectedStatus(request,match->modifier,match->pattern,rule->body.sid);
+									break;
+								}
+								fprintf(stderr,"Error: Can not control server responses, please remove this rule or use the built-in responder (sid: %s)\n",rule->body.sid.c_str());
+								if(continueOnError==0){
+									curl_slist_free_all(header);
+									return 0;
+								}
+								break;
+						}
+						case HTTP_CLIENT_BODY: //client_body. This possibly adds a body also to GET requests, which is not illegal but useless because server is not allowed to interpret it.
+							    //remove \n and \r from string
+								{clientBody=clientBody+(removeCRLF(match->pattern,rule->body.sid));
+								break;
+						}
+						case HTTP_COOKIE://cookie
+						case HTTP_RAW_COOKIE://raw_cookie
+								{//this way it only copies the value from the rule, meaning it might not always result in a name=value pair.
+								 //this is still legal and accepted by servers.
+									cookies=cookies+match->pattern;
+								break;
+						}
+						default:{
+							fprintf(stderr,"HTTP content modifier unsupported! Aborting\n");
+							curl_slist_free_all(header);
+							return 0;
+						}
+
+			}
+    	}else{
+			//we dont have to care about nocasePcre because chars will be generated exactly how given in pcre...
+				std::string pcreString=match->pattern;
+				//remove newline chars in pcre, fgets only reads one line and in most of our cases they are useless anyway
+				std::string::size_type at=0;
+				std::string crlf="\\r\\n";
+				while (true){
+					at=pcreString.find(crlf,at);
+					if(at!= std::string::npos){
+						//do not remove \r\n if it is negated
+						if(pcreString.at(at-1)!='^'){
+							pcreString.erase(at, crlf.length());
+							fprintf(stderr,"WARNING: Removed \\r\\n in pcre for rule sid:%s\n",rule->body.sid.c_str());
+						}else{
+							at=at+crlf.length();
+						}
+					}else{
+						break;
+					}
+
+				}
+				//replace non-supported signs and replace stuff that makes problems with equivalent save stuff
+				pcreString=sanitizePCRE(pcreString, rule->body.sid);
+
+				//search for character classes exrex does not support and warn, the native generator knows them
+				if(externalPcreGenerator&&(pcreString.find("\\C")!=std::string::npos||pcreString.find("\\D")!=std::string::npos||pcreString.find("\\h")!=std::string::npos
+						||pcreString.find("\\H")!=std::string::npos||pcreString.find("\\N")!=std::string::npos||pcreString.find("\\p")!=std::string::npos
+						||pcreString.find("\\R")!=std::string::npos||pcreString.find("\\S")!=std::string::npos||pcreString.find("\\v")!=std::string::npos
+						||pcreString.find("\\V")!=std::string::npos||pcreString.find("\\w")!=std::string::npos||pcreString.find("\\W")!=std::string::npos
+						||pcreString.find("\\X")!=std::string::npos)
+				){
+					fprintf(stderr,"WARNING: The pcre in this rule contains one of the not supported character classes: \\C, \\D, \\h, \\H, \\N, \\p, \\P, \\R, \\S, \\v, \\V, \\w, \\W, \\X. sid:%s\n",rule->body.sid.c_str());
+
+				}
+
+				//search for unsupported quantifiers and warn
+				if(pcreString.find("?+")!=std::string::npos||pcreString.find("??")!=std::string::npos||pcreString.find("*+")!=std::string::npos
+						||pcreString.find("++")!=std::string::npos
+				){
+					fprintf(stderr,"WARNING: The pcre in this rule contains one of the not supported quantifiers: ?+, ??, *+, ++. sid:%s\n",rule->body.sid.c_str());
+
+				}
+
+				//is it ok if whitespaces occur in uri pcres? -->yes it seems so...
+				if(externalPcreGenerator&&(pcreString.find(' ')!=std::string::npos)&&(match->modifier!=HTTP_URI)){
+					fprintf(stderr,"WARNING: non-encoded whitespace in non-uri pcre in rule with sid:%s. Could lead to problems with pcre generation engine.\n",rule->body.sid.c_str());
+				}
+				//go!
+				if(payloadVariants>1){
+					unsigned long variantCount;
+					pcrePayload=generatePcreVariant(pcreString,rule->body.sid,variant,&variantCount);
+					variants=std::max(variants,variantCount);
+				}else{
+					pcrePayload=generateStringFromPCRE(pcreString,rule->body.sid);
+				}
+
+				if(pcrePayload==""){
+					fprintf(stderr,"WARNING: pcre engine produced empty pcre for pcre:%s, rule sid:%s\n",pcreString.c_str(),rule->body.sid.c_str());
+				}
+				//strange newlines are introduced, remove them
+				pcrePayload.erase(std::remove(pcrePayload.begin(), pcrePayload.end(), '\n'), pcrePayload.end());
+				pcrePayload.erase(std::remove(pcrePayload.begin(), pcrePayload.end(), '\r'), pcrePayload.end());
+				//libcurl does not like # sign, remove it. The raw backend sends it as it is
+				if(!rawBackend&&!pcapExport){
+					pcrePayload.erase(std::remove(pcrePayload.begin(), pcrePayload.end(), '#'), pcrePayload.end());
+				}
+
+
+				switch(match->modifier){
+					case HTTP_METHOD:{//http_method
+						if(pcrePayload=="GET"){
+							request->method=preparedRequest::GET;
+						}else if(pcrePayload=="POST"){
+							request->method=preparedRequest::POST;
+						//for everything else use the given method string
+						}else{
+							request->method=preparedRequest::CUSTOM;
+							request->customMethod=pcrePayload;
+						}
+						break;
+					}
+					case HTTP_URI://http_uri
+					case HTTP_RAW_URI://http_raw_uri
+							{
+
+								if(pcrePayload.find("//")!=std::string::npos){
+								fprintf(stderr,"WARNING: The pcre HTTP uri used for this rule contains multiple slashes. Make sure that your IDS config does not normalize them. sid: %s\n",rule->body.sid.c_str());
+								}
+							    //check for whitespace, if at least one found, replace them all with +, which is http conform and  while ' ' in uri is not...
+								for(uint32_t i=0;i<pcrePayload.length();i++){
+									if(pcrePayload.at(i)==' '){
+										std::replace( pcrePayload.begin(), pcrePayload.end(), ' ', '+');
+									}
+								}
+								//this might lead to multiple slashes, but it should not make a difference for detection.
+								hostUri=hostUri+pcrePayload;
+							break;
+					}
+					case HTTP_HEADER://header
+					case HTTP_RAW_HEADER://raw_header
+							{
+							header=curl_slist_append(header, sanitizeHeader(pcrePayload,rule->body.sid).c_str());
+							break;
+					}
+					case HTTP_STAT_MSG://http_stat_msg
+					case HTTP_STAT_CODE://http_stat_code
+							{if(responseRules){
+								setExpectedStatus(request,match->modifier,pcrePayload,rule->body.sid);
+								break;
+							}
+							fprintf(stderr,"Error: can not control server responses, please remove this rule or use the built-in responder (sid: %s)\n",rule->body.sid.c_str());
+							if(continueOnError==0){
+								curl_slist_free_all(header);
+								return 0;
+							}
+							break;
+					}
+					case HTTP_CLIENT_BODY://client_body. This possibly adds a body also to GET requests, which is not illegal but useless because server is not allowed to interpret it.
+							//it is not useless for our purposes!!
+							{clientBody=clientBody+pcrePayload;
+							break;
+					}
+					case HTTP_COOKIE://cookie
+					case HTTP_RAW_COOKIE://raw_cookie
+							{//this way it only copies the value from the rule, meaning it might not always result in a name=value pair.
+							 //this is still legal and accepted by servers.
+								cookies=cookies+pcrePayload;
+							break;
+					}
+					default:{
+							fprintf(stderr,"PCRE content modifier unsupported! Aborting\n");
+							curl_slist_free_all(header);
+							return 0;
+					}
+				}//switch
+			//}
+    	}
+    }
+    //check uri for unsafe and unwise characters rfc-1738, rfc-2396
+    // * Hmm, this should probably be done during parsing, and not before sending...
+    checkUri(hostUri,rule->body.sid.c_str());
+    if(hostUri!=""){
+		//put one slash at beginning if there is none
+		if(hostUri.at(0)!='/'){
+			hostUri.insert(0,"/");
+		}
+    }
+    //prepend host to uri as libcurl does not
+    hostUri.insert(0,host);
+	std::string content="Rulesid: ";
+	content=content+rule->body.sid.c_str();
+	//add custom headers from above NOTE: do not append crlf at the end, is done automatically
+	header=curl_slist_append(header, content.c_str());
+
+    request->url=hostUri;
+    request->header.reset(header);
+    request->cookies=cookies;
+    //the client body is only sent if a rule added something
+    request->hasClientBody=clientBody!="12345";
+    request->clientBody=clientBody;
+    request->sid=rule->body.sid;
+    request->variant=variant;
+    request->modifierMask=0;
+    for(unsigned long j=0;j<rule->body.matches.size();j++){
+    	if(!rule->body.matches[j].has(ruleMatch::NEGATED)){
+    		request->modifierMask|=1<<rule->body.matches[j].modifier;
+    	}
+    }
+    if(rawBackend||pcapExport){
+    	serializeRawRequest(request);
+    }
+    return variants;
+}
+
+/**
+ * prepares the requests for all given rules, requests[i] belongs to rules[i].
+ * With --variants every rule gets one request per distinct variant instead, the requests of a rule follow each other.
+ * Returns false if a rule can not be sent, its requests are left out then
+ */
+bool prepareRulePackets(std::vector<snortRule>* rules, std::string host, std::vector<preparedRequest>* requests){
+	bool complete=true;
+	requests->clear();
+	if(payloadVariants<=1){
+		requests->reserve(rules->size());
+	}
+	for(unsigned long i=0;i<rules->size();i++){
+		unsigned long variants=1;
+		for(unsigned long variant=0;variant<variants;variant++){
+			requests->emplace_back();
+			variants=prepareRulePacket(&rules->at(i),host,&requests->back(),variant);
+			if(variants==0){
+				requests->pop_back();
+				complete=false;
+			}
+		}
+	}
+	return complete;
+}
+
+/**
+ * sets up the given (clean) curl easy handle to send the given prepared request, nothing is built or copied here.
+ * The transfer remembers the request for finishRulePacket().
+ */
+void applyPreparedRequest(const preparedRequest* request, bool verbose, CURL* handle, rulePacketTransfer* transfer){
+    if(verbose){
+    	fprintf(stdout,"\n--------------------------------------------------------\n");
+    	fprintf(stdout,"INFO: Starting to send packet # %d, for ruleSid %s\n", packetCounter, request->sid.c_str());
+    	fprintf(stdout,"--------------------------------------------------------\n");
+    }
+	//with the following curl reports an error for every fail message of the server e.g. 404, 403 but not 100...
+	//curl_easy_setopt (handle, CURLOPT_FAILONERROR, 1L);
+	//tell curl to use custom function to handle return data instead of writing it to stdout
+	curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, write_data);
+	if(responseSink!=NULL){
+		curl_easy_setopt(handle, CURLOPT_WRITEDATA, transfer);
+		curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, write_data);
+		curl_easy_setopt(handle, CURLOPT_HEADERDATA, transfer);
+	}else{
+		//the default would be stdout
+		curl_easy_setopt(handle, CURLOPT_WRITEDATA, NULL);
+	}
+	//use http protocol, is default anyway so just to make sure
+	curl_easy_setopt(handle, CURLOPT_PROTOCOLS, CURLPROTO_HTTP);
+	switch(request->method){
+		case preparedRequest::GET:
+			curl_easy_setopt(handle, CURLOPT_HTTPGET, 1L);
+			break;
+		case preparedRequest::POST:
+			curl_easy_setopt(handle, CURLOPT_POST, 1L);
+			break;
+		case preparedRequest::CUSTOM:
+			curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, request->customMethod.c_str());
+			break;
+	}
+    //set cookies
+    if(request->cookies!=""){
+    	curl_easy_setopt(handle, CURLOPT_COOKIE, request->cookies.c_str());
+    }
+	//set custom set of headers
+	curl_easy_setopt(handle, CURLOPT_HTTPHEADER, request->header.get());
+    //tell curl which host and uri to use
+    curl_easy_setopt(handle, CURLOPT_URL, request->url.c_str());
+    //add client body, if set
+    if(request->hasClientBody){
+    	curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE, (long)request->clientBody.size());
+    	curl_easy_setopt(handle, CURLOPT_POSTFIELDS, request->clientBody.c_str());
+    }else if(request->method==preparedRequest::POST){
+    	//without any POSTFIELDS curl would read the body from stdin
+    	curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE, 0L);
+    	curl_easy_setopt(handle, CURLOPT_POSTFIELDS, "");
+    }
+    if(verbose){
+    	curl_easy_setopt(handle, CURLOPT_VERBOSE, 1L);
+    }
+    //set request timeout in secs
+    curl_easy_setopt(handle, CURLOPT_TIMEOUT, 3);
+    //so that the concurrent engine finds the transfer belonging to a finished handle
+    curl_easy_setopt(handle, CURLOPT_PRIVATE, transfer);
+
+    transfer->handle=handle;
+    transfer->request=request;
+	packetCounter++;
+}
+
+/**
+ * outcome and timings of one request, times in microseconds since the request was started, 0 if unknown
+ */
+class requestResult {
+	public:
+		const preparedRequest* request=NULL;
+		uint64_t dns=0;
+		uint64_t connect=0;
+		uint64_t firstByte=0;
+		uint64_t total=0;
+		//0 if no response was received
+		long status=0;
+		//curl error code, CURLE_OK if the request did not fail. The raw backend uses CURLE_RECV_ERROR, CURLE_SEND_ERROR, CURLE_COULDNT_CONNECT and CURLE_OPERATION_TIMEDOUT
+		int error=CURLE_OK;
+};
+
+/**
+ * histogram of latencies with logarithmic buckets, adding a value is constant time and memory does not grow with the number of requests
+ */
+class latencyHistogram {
+	public:
+		unsigned long buckets[LATENCYBUCKETS]={0};
+		unsigned long count=0;
+		uint64_t sum=0;
+		uint64_t min=UINT64_MAX;
+		uint64_t max=0;
+
+		void add(uint64_t microseconds){
+			int bucket=0;
+			while(bucket<LATENCYBUCKETS-1&&(microseconds>>(bucket+1))!=0){
+				bucket++;
+			}
+			buckets[bucket]++;
+			count++;
+			sum+=microseconds;
+			min=std::min(min,microseconds);
+			max=std::max(max,microseconds);
+		}
+
+		void merge(const latencyHistogram& other){
+			for(int i=0;i<LATENCYBUCKETS;i++){
+				buckets[i]+=other.buckets[i];
+			}
+			count+=other.count;
+			sum+=other.sum;
+			min=std::min(min,other.min);
+			max=std::max(max,other.max);
+		}
+
+		/**
+		 * upper bound of the bucket that holds the given fraction (0..1) of all values
+		 */
+		uint64_t percentile(double fraction){
+			unsigned long seen=0;
+			for(int i=0;i<LATENCYBUCKETS;i++){
+				seen+=buckets[i];
+				if(count>0&&seen>=fraction*count){
+					return std::min(max,(uint64_t(2)<<i)-1);
+				}
+			}
+			return max;
+		}
+
+		void writeJson(FILE* out){
+			fprintf(out,"{\"count\": %lu, \"min_us\": %lu, \"mean_us\": %.1f, \"p50_us\": %lu, \"p90_us\": %lu, \"p99_us\": %lu, \"max_us\": %lu, \"buckets\": [",
+					count,(unsigned long)(count>0?min:0),count>0?(double)sum/count:0.0,(unsigned long)percentile(0.5),(unsigned long)percentile(0.9),
+					(unsigned long)percentile(0.99),(unsigned long)max);
+			//bucket i is written as [upper bound in us, count], empty buckets are left out
+			bool first=true;
+			for(int i=0;i<LATENCYBUCKETS;i++){
+				if(buckets[i]>0){
+					fprintf(out,"%s[%lu, %lu]",first?"":", ",(unsigned long)((uint64_t(2)<<i)-1),buckets[i]);
+					first=false;
+				}
+			}
+			fprintf(out,"]}");
+		}
+};
+
+/**
+ * aggregates the results of all requests: latency histograms overall and per http modifier, status codes and errors.
+ * Optionally every single result is written as a CSV line, the aggregate is written as JSON at the end of the run.
+ */
+class requestStatistics {
+	public:
+		~requestStatistics(){
+			if(csv!=NULL){
+				fclose(csv);
+			}
+		}
+
+		bool openCsv(std::string fileName){
+			csv=fopen(fileName.c_str(),"w");
+			if(csv==NULL){
+				return false;
+			}
+			fprintf(csv,"sid,status,error,dns_us,connect_us,first_byte_us,total_us\n");
+			return true;
+		}
+
+		void begin(){
+			startTime=std::chrono::steady_clock::now();
+		}
+
+		//count finished requests per sid, to compare them with what the built-in responder received
+		bool countSids=false;
+		std::unordered_map<std::string,unsigned long> sentPerSid;
+
+		void record(const requestResult* result){
+			dns.add(result->dns);
+			connect.add(result->connect);
+			firstByte.add(result->firstByte);
+			total.add(result->total);
+			for(int i=0;i<HTTP_MODIFIERCOUNT;i++){
+				if(result->request->modifierMask&(1<<i)){
+					perModifier[i].add(result->total);
+				}
+			}
+			statusCounts[result->status]++;
+			if(countSids){
+				sentPerSid[result->request->sid]++;
+			}
+			if(result->error!=CURLE_OK){
+				errorCounts[result->error]++;
+			}
+			if(csv!=NULL){
+				fprintf(csv,"%s,%ld,%d,%lu,%lu,%lu,%lu\n",result->request->sid.c_str(),result->status,result->error,(unsigned long)result->dns,
+						(unsigned long)result->connect,(unsigned long)result->firstByte,(unsigned long)result->total);
+			}
+		}
+
+		/**
+		 * writes everything aggregated so far as text lines, for the coordinator of worker processes
+		 */
+		void writeReport(FILE* out){
+			for(int i=0;i<4+HTTP_MODIFIERCOUNT;i++){
+				latencyHistogram* histogram=histogramAt(i);
+				fprintf(out,"histogram %d %lu %lu %lu %lu",i,histogram->count,(unsigned long)histogram->sum,(unsigned long)histogram->min,(unsigned long)histogram->max);
+				for(int j=0;j<LATENCYBUCKETS;j++){
+					fprintf(out," %lu",histogram->buckets[j]);
+				}
+				fprintf(out,"\n");
+			}
+			for(std::map<long,unsigned long>::iterator i=statusCounts.begin();i!=statusCounts.end();i++){
+				fprintf(out,"status %ld %lu\n",i->first,i->second);
+			}
+			for(std::map<int,unsigned long>::iterator i=errorCounts.begin();i!=errorCounts.end();i++){
+				fprintf(out,"error %d %lu\n",i->first,i->second);
+			}
+			fprintf(out,"end\n");
+		}
+
+		/**
+		 * adds a report written by writeReport() to these statistics, returns false if it is incomplete
+		 */
+		bool readReport(FILE* in){
+			char type[16];
+			while(fscanf(in,"%15s",type)==1){
+				if(strcmp(type,"end")==0){
+					return true;
+				}else if(strcmp(type,"histogram")==0){
+					int index;
+					latencyHistogram histogram;
+					unsigned long sum,min,max;
+					if(fscanf(in,"%d %lu %lu %lu %lu",&index,&histogram.count,&sum,&min,&max)!=5||index<0||index>=4+HTTP_MODIFIERCOUNT){
+						return false;
+					}
+					histogram.sum=sum;
+					histogram.min=min;
+					histogram.max=max;
+					for(int j=0;j<LATENCYBUCKETS;j++){
+						if(fscanf(in,"%lu",&histogram.buckets[j])!=1){
+							return false;
+						}
+					}
+					histogramAt(index)->merge(histogram);
+				}else if(strcmp(type,"status")==0){
+					long status;
+					unsigned long count;
+					if(fscanf(in,"%ld %lu",&status,&count)!=2){
+						return false;
+					}
+					statusCounts[status]+=count;
+				}else if(strcmp(type,"error")==0){
+					int error;
+					unsigned long count;
+					if(fscanf(in,"%d %lu",&error,&count)!=2){
+						return false;
+					}
+					errorCounts[error]+=count;
+				}else{
+					return false;
+				}
+			}
+			return false;
+		}
+
+		/**
+		 * writes the aggregated statistics of the run as JSON
+		 */
+		bool writeJson(std::string fileName){
+			double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-startTime).count();
+			FILE* out=fopen(fileName.c_str(),"w");
+			if(out==NULL){
+				return false;
+			}
+			fprintf(out,"{\n\"requests\": %lu,\n\"seconds\": %.3f,\n\"requests_per_second\": %.1f,\n",total.count,seconds,seconds>0?total.count/seconds:0.0);
+			fprintf(out,"\"status\": {");
+			for(std::map<long,unsigned long>::iterator i=statusCounts.begin();i!=statusCounts.end();i++){
+				fprintf(out,"%s\"%ld\": %lu",i==statusCounts.begin()?"":", ",i->first,i->second);
+			}
+			fprintf(out,"},\n\"errors\": {");
+			for(std::map<int,unsigned long>::iterator i=errorCounts.begin();i!=errorCounts.end();i++){
+				fprintf(out,"%s\"%s\": %lu",i==errorCounts.begin()?"":", ",curl_easy_strerror((CURLcode)i->first),i->second);
+			}
+			fprintf(out,"},\n\"dns\": ");
+			dns.writeJson(out);
+			fprintf(out,",\n\"connect\": ");
+			connect.writeJson(out);
+			fprintf(out,",\n\"first_byte\": ");
+			firstByte.writeJson(out);
+			fprintf(out,",\n\"total\": ");
+			total.writeJson(out);
+			fprintf(out,",\n\"total_per_modifier\": {");
+			bool first=true;
+			for(int i=HTTP_METHOD;i<HTTP_MODIFIERCOUNT;i++){
+				if(perModifier[i].count>0){
+					fprintf(out,"%s\n\t\"%s\": ",first?"":",",httpModifierNames[i]);
+					perModifier[i].writeJson(out);
+					first=false;
+				}
+			}
+			fprintf(out,"\n}\n}\n");
+			fclose(out);
+			return true;
+		}
+
+	private:
+		latencyHistogram dns;
+		latencyHistogram connect;
+		latencyHistogram firstByte;
+		latencyHistogram total;
+		latencyHistogram perModifier[HTTP_MODIFIERCOUNT];
+		std::map<long,unsigned long> statusCounts;
+		std::map<int,unsigned long> errorCounts;
+		FILE* csv=NULL;
+		std::chrono::steady_clock::time_point startTime;
+
+		//dns, connect, first byte, total and then the histograms per modifier
+		latencyHistogram* histogramAt(int index){
+			switch(index){
+				case 0:
+					return &dns;
+				case 1:
+					return &connect;
+				case 2:
+					return &firstByte;
+				case 3:
+					return &total;
+				default:
+					return &perModifier[index-4];
+			}
+		}
+};
+
+requestStatistics statistics;
+
+/**
+ * reports the result of a finished transfer and frees everything that was allocated for it, except the handle which goes back to its pool
+ */
+void finishRulePacket(rulePacketTransfer* transfer, CURLcode result){
+	finishedRequests++;
+	if(result != CURLE_OK){
+			failedRequests++;
+			fprintf(stderr, "curl_easy_perform() failed for packet from rule sid %s, with url %s, with error: %s.\n",transfer->request->sid.c_str(),transfer->request->url.c_str(), curl_easy_strerror(result));
+	}
+	requestResult outcome;
+	curl_off_t time;
+	outcome.request=transfer->request;
+	outcome.error=result;
+	curl_easy_getinfo(transfer->handle, CURLINFO_RESPONSE_CODE, &outcome.status);
+	if(curl_easy_getinfo(transfer->handle, CURLINFO_NAMELOOKUP_TIME_T, &time)==CURLE_OK){
+		outcome.dns=time;
+	}
+	if(curl_easy_getinfo(transfer->handle, CURLINFO_CONNECT_TIME_T, &time)==CURLE_OK){
+		outcome.connect=time;
+	}
+	if(curl_easy_getinfo(transfer->handle, CURLINFO_STARTTRANSFER_TIME_T, &time)==CURLE_OK){
+		outcome.firstByte=time;
+	}
+	if(curl_easy_getinfo(transfer->handle, CURLINFO_TOTAL_TIME_T, &time)==CURLE_OK){
+		outcome.total=time;
+	}
+	statistics.record(&outcome);
+	if(responseSink!=NULL){
+		responseSink->add(transfer->request->sid,outcome.status,transfer->response.data(),transfer->responseLength);
+		transfer->response.clear();
+		transfer->responseLength=0;
+	}
+	long usedPort;
+	result = curl_easy_getinfo(transfer->handle, CURLINFO_LOCAL_PORT, &usedPort);
+	if(result==CURLE_OK) {
+		printf("Local port used for this request: %ld\n", usedPort);
+	}else{
+		printf("Failure in getting local port\n");
+	}
+	transfer->handle=NULL;
+	transfer->request=NULL;
+}
+
+/**
+ * sends the given prepared request and waits for the response
+ */
+void sendRulePacket(const preparedRequest* request, bool verbose, curlHandlePool* pool){
+	rulePacketTransfer transfer;
+	CURL *handle=pool->acquire();
+	applyPreparedRequest(request, verbose, handle, &transfer);
+    //do it!
+	CURLcode result=curl_easy_perform(handle);
+	finishRulePacket(&transfer, result);
+	pool->release(handle);
+}
+
+/**
+ * paces outgoing requests to a target rate with a token bucket.
+ * The rate can be fixed, a linear ramp from one rate to another or a profile of steps. Tokens are refilled from the rate integrated
+ * over the elapsed time, so at high rates several requests are released per wakeup instead of sleeping before every single request.
+ */
+class sendRateLimiter {
+	public:
+		enum profileType {UNLIMITED, FIXED, RAMP, STEPS};
+
+		/**
+		 * parses a profile specification, returns false if it is malformed:
+		 * FIXED: <rps>, RAMP: <startRps>:<endRps>:<seconds>, STEPS: <rps>:<seconds>[,<rps>:<seconds>...]
+		 */
+		bool configure(profileType profileType, std::string spec){
+			std::size_t start=0;
+			std::size_t end;
+			double rate,seconds;
+			char tail;
+			profile=profileType;
+			steps.clear();
+			switch(profile){
+				case FIXED:
+					if(sscanf(spec.c_str(),"%lf%c",&rate,&tail)!=1||rate<=0){
+						return false;
+					}
+					steps.push_back(std::make_pair(rate,0.0));
+					return true;
+				case RAMP:
+					if(sscanf(spec.c_str(),"%lf:%lf:%lf%c",&rampFrom,&rampTo,&rampSeconds,&tail)!=3||rampFrom<0||rampTo<0||rampSeconds<=0){
+						return false;
+					}
+					return true;
+				case STEPS:
+					while(start<spec.size()){
+						end=spec.find(',',start);
+						if(end==std::string::npos){
+							end=spec.size();
+						}
+						if(sscanf(spec.substr(start,end-start).c_str(),"%lf:%lf%c",&rate,&seconds,&tail)!=2||rate<0||seconds<=0){
+							return false;
+						}
+						steps.push_back(std::make_pair(rate,seconds));
+						start=end+1;
+					}
+					return !steps.empty();
+				default:
+					return true;
+			}
+		}
+
+		bool limited(){
+			return profile!=UNLIMITED;
+		}
+
+		/**
+		 * multiplies all rates of the profile, e.g. to split it among worker processes
+		 */
+		void scale(double factor){
+			for(unsigned long i=0;i<steps.size();i++){
+				steps[i].first*=factor;
+			}
+			rampFrom*=factor;
+			rampTo*=factor;
+		}
+
+		/**
+		 * starts the clock, the profile begins now
+		 */
+		void begin(){
+			startTime=std::chrono::steady_clock::now();
+			lastUpdate=0;
+			tokens=1;
+			sent=0;
+			expected=0;
+		}
+
+		/**
+		 * target rate in requests per second at the given number of seconds after begin()
+		 */
+		double targetRate(double elapsed){
+			double stepEnd=0;
+			switch(profile){
+				case FIXED:
+					return steps[0].first;
+				case RAMP:
+					if(elapsed>=rampSeconds){
+						return rampTo;
+					}
+					return rampFrom+(rampTo-rampFrom)*elapsed/rampSeconds;
+				case STEPS:
+					for(unsigned long i=0;i<steps.size();i++){
+						stepEnd+=steps[i].second;
+						if(elapsed<stepEnd){
+							return steps[i].first;
+						}
+					}
+					//the last step lasts until the end of the run
+					return steps.back().first;
+				default:
+					return 0;
+			}
+		}
+
+		/**
+		 * takes a token if one is available, never blocks
+		 */
+		bool tryAcquire(){
+			if(!limited()){
+				sent++;
+				return true;
+			}
+			refill();
+			if(tokens>=1){
+				tokens-=1;
+				sent++;
+				return true;
+			}
+			return false;
+		}
+
+		/**
+		 * seconds until the next token is available, 0 if there is one
+		 */
+		double waitTime(){
+			double rate;
+			if(!limited()){
+				return 0;
+			}
+			refill();
+			if(tokens>=1){
+				return 0;
+			}
+			rate=targetRate(lastUpdate);
+			if(rate<=0){
+				//paused, check again later
+				return 0.001;
+			}
+			return (1-tokens)/rate;
+		}
+
+		/**
+		 * waitTime() rounded up to whole milliseconds for poll timeouts, never 0 while a wait is needed so pollers do not spin
+		 */
+		int waitMilliseconds(){
+			return (int)ceil(waitTime()*1000);
+		}
+
+		/**
+		 * blocks until a request may be sent and takes its token.
+		 * Sleeps only if the next token is further away than the sleep granularity, otherwise yields.
+		 */
+		void acquire(){
+			double wait;
+			while(!tryAcquire()){
+				wait=waitTime();
+				if(wait>0.0002){
+					std::this_thread::sleep_for(std::chrono::duration<double>(wait-0.0001));
+				}else{
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		/**
+		 * prints the achieved rate against the target rate of the profile
+		 */
+		void report(){
+			double elapsed;
+			if(!limited()){
+				return;
+			}
+			refill();
+			elapsed=lastUpdate;
+			if(elapsed<=0){
+				return;
+			}
+			fprintf(stdout,"Rate: sent %lu requests in %.3f s, achieved %.1f requests/s, target %.1f requests/s (%.1f%%)\n",
+					sent,elapsed,sent/elapsed,expected/elapsed,expected>0?100.0*sent/expected:100.0);
+		}
+
+	private:
+		profileType profile=UNLIMITED;
+		//rate and duration of every step, a fixed rate is a single step
+		std::vector<std::pair<double,double> > steps;
+		double rampFrom=0;
+		double rampTo=0;
+		double rampSeconds=0;
+		std::chrono::steady_clock::time_point startTime;
+		//seconds after begin() of the last refill
+		double lastUpdate=0;
+		double tokens=0;
+		//number of requests the profile allowed so far
+		double expected=0;
+		unsigned long sent=0;
+
+		/**
+		 * adds the tokens of the time passed since the last refill, at most a few milliseconds worth of requests are kept as burst
+		 */
+		void refill(){
+			double now=std::chrono::duration<double>(std::chrono::steady_clock::now()-startTime).count();
+			double rate=targetRate((now+lastUpdate)/2);
+			double added=rate*(now-lastUpdate);
+			double burst=std::max(1.0,rate*RATEBURSTSECONDS);
+			expected+=added;
+			tokens=std::min(tokens+added,burst);
+			lastUpdate=now;
+		}
+};
+
+/**
+ * repeats the whole rule set for a number of iterations or a wall clock duration, whatever ends first.
+ * Without any of them the rule set is sent exactly once. Prints the throughput every reportInterval seconds, so long runs can be watched.
+ */
+class soakRun {
+	public:
+		//0 means no limit, unless duration is not set either
+		unsigned long iterations=0;
+		//seconds, 0 means no limit
+		double duration=0;
+		//generate new pcre payloads for every iteration, so the IDS does not see the same requests again and again
+		bool regenerate=false;
+		double reportInterval=SOAKREPORTSECONDS;
+
+		bool enabled(){
+			return iterations!=0||duration>0;
+		}
+
+		void begin(){
+			startTime=std::chrono::steady_clock::now();
+			lastReport=0;
+			lastFinished=finishedRequests;
+			iteration=0;
+		}
+
+		/**
+		 * returns true if another iteration of the rule set should be sent and counts it
+		 */
+		bool nextIteration(){
+			if(iteration>0&&!enabled()){
+				return false;
+			}
+			if((iterations!=0&&iteration>=iterations)||expired()){
+				return false;
+			}
+			iteration++;
+			return true;
+		}
+
+		unsigned long currentIteration(){
+			return iteration;
+		}
+
+		/**
+		 * true if the duration is over, senders stop starting new requests then
+		 */
+		bool expired(){
+			return duration>0&&elapsed()>=duration;
+		}
+
+		/**
+		 * prints a throughput report if the report interval passed since the last one
+		 */
+		void report(){
+			double now;
+			if(!enabled()){
+				return;
+			}
+			now=elapsed();
+			if(now-lastReport<reportInterval){
+				return;
+			}
+			fprintf(stdout,"Soak: %.0f s, iteration %lu, %lu requests since last report (%.1f requests/s), %lu requests total, %lu failed\n",
+					now,iteration,finishedRequests-lastFinished,now>lastReport?(finishedRequests-lastFinished)/(now-lastReport):0.0,
+					finishedRequests,failedRequests);
+			lastReport=now;
+			lastFinished=finishedRequests;
+		}
+
+		/**
+		 * prints the throughput of the whole soak run
+		 */
+		void summary(){
+			double now;
+			if(!enabled()){
+				return;
+			}
+			now=elapsed();
+			fprintf(stdout,"Soak finished: %.1f s, %lu iterations, %lu requests total (%.1f requests/s), %lu failed\n",
+					now,iteration,finishedRequests,now>0?finishedRequests/now:0.0,failedRequests);
+		}
+
+	private:
+		std::chrono::steady_clock::time_point startTime;
+		double lastReport=0;
+		unsigned long lastFinished=0;
+		unsigned long iteration=0;
+
+		double elapsed(){
+			return std::chrono::duration<double>(std::chrono::steady_clock::now()-startTime).count();
+		}
+};
+
+/**
+ * sends all given prepared requests with at most concurrency requests in flight at the same time (curl multi interface).
+ * Every request is set up exactly the same way as in sendRulePacket(), only the waiting for responses overlaps.
+ * New requests are only started when the rate limiter allows it and the soak run is not over.
+ */
+void sendRulePacketsConcurrent(std::vector<preparedRequest>* requests, bool verbose, int concurrency, curlHandlePool* pool, sendRateLimiter* limiter, soakRun* soak){
+	CURLM *multiHandle;
+	CURLMsg *message;
+	rulePacketTransfer *transfer;
+	std::vector<rulePacketTransfer> transfers(concurrency);
+	std::vector<rulePacketTransfer*> freeTransfers;
+	unsigned long nextRequest=0;
+	int running=0;
+	int messagesLeft;
+	int waitMilliseconds;
+	CURL *handle;
+
+	multiHandle=curl_multi_init();
+	if(multiHandle==NULL){
+		fprintf(stderr,"Could not initialize curl multi handle. Aborting!\n");
+		exit(1);
+	}
+	for(int i=concurrency-1;i>=0;i--){
+		freeTransfers.push_back(&transfers[i]);
+	}
+
+	while(nextRequest<requests->size()||running>0){
+		if(soak->expired()){
+			//let the requests in flight finish, but do not start new ones
+			nextRequest=requests->size();
+		}
+		//fill up free slots with the next requests
+		while(nextRequest<requests->size()&&!freeTransfers.empty()&&limiter->tryAcquire()){
+			transfer=freeTransfers.back();
+			freeTransfers.pop_back();
+			handle=pool->acquire();
+			applyPreparedRequest(&requests->at(nextRequest), verbose, handle, transfer);
+			curl_multi_add_handle(multiHandle, handle);
+			nextRequest++;
+			running++;
+		}
+		curl_multi_perform(multiHandle, &running);
+		//collect finished transfers, their slots can be reused right away
+		while((message=curl_multi_info_read(multiHandle, &messagesLeft))!=NULL){
+			if(message->msg==CURLMSG_DONE){
+				curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &transfer);
+				handle=message->easy_handle;
+				curl_multi_remove_handle(multiHandle, handle);
+				finishRulePacket(transfer, message->data.result);
+				pool->release(handle);
+				freeTransfers.push_back(transfer);
+			}
+		}
+		soak->report();
+		if(nextRequest<requests->size()&&!freeTransfers.empty()){
+			//a slot is free, but the rate limiter holds the next request back
+			waitMilliseconds=limiter->waitMilliseconds();
+			if(waitMilliseconds>0){
+				curl_multi_poll(multiHandle, NULL, 0, waitMilliseconds, NULL);
+			}
+		}else if(running>0){
+			//only wait if there is nothing to add anyway
+			curl_multi_poll(multiHandle, NULL, 0, 1000, NULL);
+		}
+	}
+	curl_multi_cleanup(multiHandle);
+}
+
+/**
+ * HTTP/1.1 backend that writes the serialized requests as they are to non-blocking sockets, one thread handles all connections with epoll.
+ * Unlike libcurl nothing is normalized, so raw uris, raw headers and payloads reach the IDS byte exact.
+ * Connections are kept alive and reused as long as the server allows it.
+ */
+class rawHttpSender {
+	public:
+		rawHttpSender(bool beVerbose):verbose(beVerbose){
+			epollFd=epoll_create1(0);
+			if(epollFd<0){
+				fprintf(stderr,"Could not create epoll instance: %s. Aborting!\n",strerror(errno));
+				exit(1);
+			}
+		}
+
+		~rawHttpSender(){
+			for(unsigned long i=0;i<connections.size();i++){
+				if(connections[i].fd>=0){
+					close(connections[i].fd);
+				}
+			}
+			if(address!=NULL){
+				freeaddrinfo(address);
+			}
+			close(epollFd);
+		}
+
+		/**
+		 * sends all given requests with at most concurrency connections at the same time, paced by the rate limiter like the curl senders
+		 */
+		void send(std::vector<preparedRequest>* requests, int concurrency, sendRateLimiter* limiter, soakRun* soak){
+			std::vector<struct epoll_event> events(concurrency);
+			unsigned long nextRequest=0;
+			int waitMilliseconds;
+			int ready;
+			if(requests->empty()){
+				return;
+			}
+			resolve(&requests->at(0));
+			if(connections.size()<(unsigned long)concurrency){
+				connections.resize(concurrency);
+			}
+			while(nextRequest<requests->size()||busy>0){
+				if(soak->expired()){
+					nextRequest=requests->size();
+				}
+				//start the next requests on idle connections
+				for(unsigned long i=0;i<connections.size()&&nextRequest<requests->size();i++){
+					if(connections[i].request!=NULL){
+						continue;
+					}
+					if(!limiter->tryAcquire()){
+						break;
+					}
+					start(&connections[i],&requests->at(nextRequest));
+					nextRequest++;
+				}
+				waitMilliseconds=busy>0?100:0;
+				if(nextRequest<requests->size()&&busy<(int)connections.size()){
+					waitMilliseconds=std::min(waitMilliseconds>0?waitMilliseconds:100,limiter->waitMilliseconds());
+				}
+				ready=epoll_wait(epollFd,events.data(),events.size(),waitMilliseconds);
+				for(int i=0;i<ready;i++){
+					handle((rawConnection*)events[i].data.ptr,events[i].events);
+				}
+				expire();
+				soak->report();
+			}
+		}
+
+	private:
+		enum chunkPart {CHUNK_SIZE, CHUNK_DATA, CHUNK_TRAILER};
+
+		class rawConnection {
+			public:
+				int fd=-1;
+				//request in flight, NULL if the connection is idle
+				const preparedRequest* request=NULL;
+				bool connected=false;
+				//the request was already sent completely on this connection before, so a failure may be the server closing it
+				bool reused=false;
+				std::size_t written=0;
+				std::string response;
+				std::size_t headerEnd=0;
+				//-1 if unknown
+				long contentLength=-1;
+				bool chunked=false;
+				//chunked bodies are parsed as they arrive: the part of the chunk at chunkPosition in response
+				chunkPart chunkState=CHUNK_SIZE;
+				std::size_t chunkPosition=0;
+				std::size_t chunkRemaining=0;
+				bool closeAfterResponse=false;
+				std::chrono::steady_clock::time_point started;
+				//microseconds after started, for the statistics
+				uint64_t connectTime=0;
+				uint64_t firstByteTime=0;
+		};
+
+		bool verbose;
+		int epollFd;
+		int busy=0;
+		struct addrinfo* address=NULL;
+		std::vector<rawConnection> connections;
+
+		void resolve(const preparedRequest* request){
+			std::string authority,target,node,service="80";
+			struct addrinfo hints;
+			std::size_t colon;
+			int result;
+			if(address!=NULL){
+				return;
+			}
+			splitHttpUrl(request->url,&authority,&target);
+			node=authority;
+			colon=authority.rfind(':');
+			if(colon!=std::string::npos&&authority.find(']',colon)==std::string::npos){
+				node=authority.substr(0,colon);
+				service=authority.substr(colon+1);
+			}
+			if(node.size()>1&&node[0]=='['){
+				node=node.substr(1,node.size()-2);
+			}
+			memset(&hints,0,sizeof(hints));
+			hints.ai_family=AF_UNSPEC;
+			hints.ai_socktype=SOCK_STREAM;
+			result=getaddrinfo(node.c_str(),service.c_str(),&hints,&address);
+			if(result!=0){
+				fprintf(stderr,"Could not resolve %s: %s. Aborting!\n",authority.c_str(),gai_strerror(result));
+				exit(1);
+			}
+		}
+
+		void start(rawConnection* connection, const preparedRequest* request){
+			struct epoll_event event;
+			connection->request=request;
+			connection->written=0;
+			connection->response.clear();
+			connection->headerEnd=0;
+			connection->contentLength=-1;
+			connection->chunked=false;
+			connection->chunkState=CHUNK_SIZE;
+			connection->chunkPosition=0;
+			connection->chunkRemaining=0;
+			connection->closeAfterResponse=false;
+			connection->started=std::chrono::steady_clock::now();
+			connection->connectTime=0;
+			connection->firstByteTime=0;
+			busy++;
+			if(verbose){
+				fprintf(stdout,"\n--------------------------------------------------------\n");
+				fprintf(stdout,"INFO: Starting to send packet # %d, for ruleSid %s\n", packetCounter, request->sid.c_str());
+				fprintf(stdout,"--------------------------------------------------------\n");
+				fprintf(stdout,"%s\n",request->raw.c_str());
+			}
+			packetCounter++;
+			event.data.ptr=connection;
+			event.events=EPOLLOUT|EPOLLIN;
+			if(connection->fd>=0){
+				connection->reused=true;
+				epoll_ctl(epollFd,EPOLL_CTL_MOD,connection->fd,&event);
+				return;
+			}
+			connection->reused=false;
+			connection->connected=false;
+			connection->fd=socket(address->ai_family,SOCK_STREAM|SOCK_NONBLOCK,0);
+			if(connection->fd<0){
+				finish(connection,CURLE_COULDNT_CONNECT,"could not create socket");
+				return;
+			}
+			int noDelay=1;
+			setsockopt(connection->fd,IPPROTO_TCP,TCP_NODELAY,&noDelay,sizeof(noDelay));
+			if(connect(connection->fd,address->ai_addr,address->ai_addrlen)!=0&&errno!=EINPROGRESS){
+				finish(connection,CURLE_COULDNT_CONNECT,strerror(errno));
+				return;
+			}
+			epoll_ctl(epollFd,EPOLL_CTL_ADD,connection->fd,&event);
+		}
+
+		void handle(rawConnection* connection, uint32_t events){
+			char buffer[65536];
+			ssize_t count;
+			if(connection->request==NULL){
+				//idle keep-alive connection closed by the server
+				closeConnection(connection);
+				return;
+			}
+			if(!connection->connected&&(events&(EPOLLOUT|EPOLLERR|EPOLLHUP))){
+				int error=0;
+				socklen_t length=sizeof(error);
+				getsockopt(connection->fd,SOL_SOCKET,SO_ERROR,&error,&length);
+				if(error!=0){
+					finish(connection,CURLE_COULDNT_CONNECT,strerror(error));
+					return;
+				}
+				connection->connected=true;
+				connection->connectTime=microsecondsSince(connection->started);
+			}
+			if(connection->written<connection->request->raw.size()&&(events&EPOLLOUT)){
+				//no SIGPIPE if the server closed the connection in the meantime
+				count=::send(connection->fd,connection->request->raw.data()+connection->written,connection->request->raw.size()-connection->written,MSG_NOSIGNAL);
+				if(count<0&&errno!=EAGAIN){
+					retryOrFinish(connection,CURLE_SEND_ERROR,strerror(errno));
+					return;
+				}
+				if(count>0){
+					connection->written+=count;
+				}
+				if(connection->written==connection->request->raw.size()){
+					struct epoll_event event;
+					event.data.ptr=connection;
+					event.events=EPOLLIN;
+					epoll_ctl(epollFd,EPOLL_CTL_MOD,connection->fd,&event);
+				}
+			}
+			if(events&(EPOLLIN|EPOLLHUP|EPOLLERR)){
+				while((count=read(connection->fd,buffer,sizeof(buffer)))>0){
+					if(connection->response.empty()){
+						connection->firstByteTime=microsecondsSince(connection->started);
+					}
+					connection->response.append(buffer,count);
+				}
+				if(count==0){
+					//server closed the connection
+					if(connection->response.empty()){
+						retryOrFinish(connection,CURLE_RECV_ERROR,"connection closed without response");
+					}else if(responseComplete(connection)||(connection->headerEnd>0&&connection->contentLength<0&&!connection->chunked)){
+						//complete, or the body ends with the connection
+						connection->closeAfterResponse=true;
+						finish(connection,CURLE_OK,NULL);
+					}else{
+						finish(connection,CURLE_RECV_ERROR,"connection closed before response was complete");
+					}
+					return;
+				}
+				if(count<0&&errno!=EAGAIN){
+					retryOrFinish(connection,CURLE_RECV_ERROR,strerror(errno));
+					return;
+				}
+				if(responseComplete(connection)){
+					finish(connection,CURLE_OK,NULL);
+				}
+			}
+		}
 
+		/**
+		 * parses the response header once it is there and checks if the whole response arrived
+		 */
+		bool responseComplete(rawConnection* connection){
+			std::string& response=connection->response;
+			if(connection->headerEnd==0){
+				std::size_t end=response.find("\r\n\r\n");
+				if(end==std::string::npos){
+					return false;
 				}
-				//replace non-supported signs and replace stuff that makes problems with equivalent save stuff
-				pcreString=sanitizePCRE(pcreString, rule->body.sid);
+				connection->headerEnd=end+4;
+				std::string header=response.substr(0,end);
+				std::transform(header.begin(),header.end(),header.begin(),::tolower);
+				std::string value;
+				if(headerValue(header,"content-length",&value)){
+					connection->contentLength=strtol(value.c_str(),NULL,10);
+				}
+				connection->chunked=headerValue(header,"transfer-encoding",&value)&&value.find("chunked")!=std::string::npos;
+				connection->chunkPosition=connection->headerEnd;
+				connection->closeAfterResponse=(headerValue(header,"connection",&value)&&value.compare(0,5,"close")==0)||header.compare(0,8,"http/1.0")==0;
+				//responses that never have a body
+				if(connection->request->method==preparedRequest::CUSTOM&&connection->request->customMethod=="HEAD"){
+					connection->contentLength=0;
+				}else if(header.size()>=12&&(header.compare(9,3,"204")==0||header.compare(9,3,"304")==0||header[9]=='1')){
+					connection->contentLength=0;
+				}
+			}
+			if(connection->chunked){
+				return chunkedBodyComplete(connection);
+			}
+			return connection->contentLength>=0&&response.size()>=connection->headerEnd+connection->contentLength;
+		}
 
-				//search for unsupported character classes and warn
-				if(pcreString.find("\\C")!=std::string::npos||pcreString.find("\\D")!=std::string::npos||pcreString.find("\\h")!=std::string::npos
-						||pcreString.find("\\H")!=std::string::npos||pcreString.find("\\N")!=std::string::npos||pcreString.find("\\p")!=std::string::npos
-						||pcreString.find("\\R")!=std::string::npos||pcreString.find("\\S")!=std::string::npos||pcreString.find("\\v")!=std::string::npos
-						||pcreString.find("\\V")!=std::string::npos||pcreString.find("\\w")!=std::string::npos||pcreString.find("\\W")!=std::string::npos
-						||pcreString.find("\\X")!=std::string::npos
-				){
-					fprintf(stderr,"WARNING: The pcre in this rule contains one of the not supported character classes: \\C, \\D, \\h, \\H, \\N, \\p, \\P, \\R, \\S, \\v, \\V, \\w, \\W, \\X. sid:%s\n",rule->body.sid.c_str());
+		/**
+		 * value of the given header field (lower case) without leading whitespace, returns false if the header does not have it
+		 */
+		static bool headerValue(const std::string& header, std::string name, std::string* value){
+			std::size_t field=header.find("\r\n"+name+":");
+			std::size_t end;
+			if(field==std::string::npos){
+				return false;
+			}
+			field+=name.size()+3;
+			while(field<header.size()&&(header[field]==' '||header[field]=='\t')){
+				field++;
+			}
+			end=header.find("\r\n",field);
+			*value=header.substr(field,end==std::string::npos?std::string::npos:end-field);
+			return true;
+		}
+
+		/**
+		 * goes on parsing the chunks that arrived since the last call: size line, data and CRLF, until the last chunk (size 0)
+		 * and its optional trailer fields end with an empty line
+		 */
+		bool chunkedBodyComplete(rawConnection* connection){
+			std::string& response=connection->response;
+			std::size_t lineEnd;
+			while(true){
+				switch(connection->chunkState){
+					case CHUNK_SIZE:{
+						lineEnd=response.find("\r\n",connection->chunkPosition);
+						if(lineEnd==std::string::npos){
+							return false;
+						}
+						const char* sizeStart=response.c_str()+connection->chunkPosition;
+						char* sizeEnd;
+						//chunk extensions after the size are ignored
+						connection->chunkRemaining=strtoul(sizeStart,&sizeEnd,16);
+						if(sizeEnd==sizeStart){
+							//not a chunk size, nothing after this can be trusted on this connection
+							connection->closeAfterResponse=true;
+							return true;
+						}
+						connection->chunkPosition=lineEnd+2;
+						connection->chunkState=connection->chunkRemaining==0?CHUNK_TRAILER:CHUNK_DATA;
+						break;
+					}
+					case CHUNK_DATA:
+						//data and the CRLF after it
+						if(response.size()-connection->chunkPosition<connection->chunkRemaining+2){
+							return false;
+						}
+						connection->chunkPosition+=connection->chunkRemaining+2;
+						connection->chunkState=CHUNK_SIZE;
+						break;
+					case CHUNK_TRAILER:
+						lineEnd=response.find("\r\n",connection->chunkPosition);
+						if(lineEnd==std::string::npos){
+							return false;
+						}
+						if(lineEnd==connection->chunkPosition){
+							return true;
+						}
+						connection->chunkPosition=lineEnd+2;
+						break;
+				}
+			}
+		}
+
+		/**
+		 * a reused keep-alive connection may have been closed by the server just before the request, send it again on a new one
+		 */
+		void retryOrFinish(rawConnection* connection, CURLcode code, const char* error){
+			const preparedRequest* request=connection->request;
+			if(connection->reused&&connection->response.empty()){
+				closeConnection(connection);
+				connection->request=NULL;
+				busy--;
+				packetCounter--;
+				start(connection,request);
+				return;
+			}
+			finish(connection,code,error);
+		}
+
+		/**
+		 * reports the result like finishRulePacket() does for curl, the connection is kept for the next request if possible
+		 */
+		void finish(rawConnection* connection, CURLcode code, const char* error){
+			requestResult outcome;
+			outcome.request=connection->request;
+			outcome.error=code;
+			outcome.connect=connection->connectTime;
+			outcome.firstByte=connection->firstByteTime;
+			outcome.total=microsecondsSince(connection->started);
+			if(connection->response.compare(0,5,"HTTP/")==0&&connection->response.size()>12){
+				outcome.status=strtol(connection->response.c_str()+9,NULL,10);
+			}
+			statistics.record(&outcome);
+			if(responseSink!=NULL){
+				responseSink->add(connection->request->sid,outcome.status,connection->response.data(),connection->response.size());
+			}
+			finishedRequests++;
+			if(error!=NULL){
+				failedRequests++;
+				fprintf(stderr, "raw request failed for packet from rule sid %s, with url %s, with error: %s.\n",connection->request->sid.c_str(),connection->request->url.c_str(),error);
+			}else if(verbose){
+				std::size_t lineEnd=connection->response.find("\r\n");
+				fprintf(stdout,"< %s\n",connection->response.substr(0,lineEnd).c_str());
+			}
+			struct sockaddr_storage local;
+			socklen_t length=sizeof(local);
+			if(connection->fd>=0&&getsockname(connection->fd,(struct sockaddr*)&local,&length)==0){
+				printf("Local port used for this request: %d\n",ntohs(local.ss_family==AF_INET6?((struct sockaddr_in6*)&local)->sin6_port:((struct sockaddr_in*)&local)->sin_port));
+			}else{
+				printf("Failure in getting local port\n");
+			}
+			if(error!=NULL||connection->closeAfterResponse){
+				closeConnection(connection);
+			}else{
+				//only watch for the server closing the idle connection
+				struct epoll_event event;
+				event.data.ptr=connection;
+				event.events=EPOLLRDHUP;
+				epoll_ctl(epollFd,EPOLL_CTL_MOD,connection->fd,&event);
+			}
+			connection->request=NULL;
+			connection->response.clear();
+			busy--;
+		}
+
+		void closeConnection(rawConnection* connection){
+			if(connection->fd>=0){
+				epoll_ctl(epollFd,EPOLL_CTL_DEL,connection->fd,NULL);
+				close(connection->fd);
+				connection->fd=-1;
+			}
+		}
+
+		static uint64_t microsecondsSince(std::chrono::steady_clock::time_point start){
+			return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-start).count();
+		}
+
+		/**
+		 * gives up requests that take longer than RAWTIMEOUTSECONDS
+		 */
+		void expire(){
+			std::chrono::steady_clock::time_point now=std::chrono::steady_clock::now();
+			for(unsigned long i=0;i<connections.size();i++){
+				if(connections[i].request!=NULL&&now-connections[i].started>std::chrono::seconds(RAWTIMEOUTSECONDS)){
+					connections[i].closeAfterResponse=true;
+					finish(&connections[i],CURLE_OPERATION_TIMEDOUT,"timeout");
+				}
+			}
+		}
+};
+
+/**
+ * writes prepared requests as complete synthetic TCP sessions into a pcap file (ethernet link type), e.g. for tcpreplay.
+ * Every session gets its own client address and port: handshake, the request in MSS sized segments, a minimal response and teardown.
+ * Packets are collected in a buffer and written in large blocks.
+ */
+class pcapWriter {
+	public:
+		~pcapWriter(){
+			close();
+		}
+
+		/**
+		 * creates the file and writes the pcap header, serverUrl gives the server address and port of all sessions
+		 */
+		bool open(std::string fileName, std::string serverUrl){
+			std::string authority,target,node,port="80";
+			std::size_t colon;
+			file=fopen(fileName.c_str(),"wb");
+			if(file==NULL){
+				return false;
+			}
+			splitHttpUrl(serverUrl,&authority,&target);
+			node=authority;
+			colon=authority.rfind(':');
+			if(colon!=std::string::npos){
+				node=authority.substr(0,colon);
+				port=authority.substr(colon+1);
+			}
+			//host names are not resolved, the Host header still carries them
+			if(inet_pton(AF_INET,node.c_str(),&serverAddress)!=1){
+				inet_pton(AF_INET,"10.0.0.1",&serverAddress);
+			}
+			serverPort=htons(atoi(port.c_str()));
+			timestamp=std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			buffer.reserve(PCAPBUFFERSIZE+65536);
+			//classic pcap header: magic, version 2.4, timezone, accuracy, snaplen, ethernet
+			append32(0xa1b2c3d4);
+			append16(2);
+			append16(4);
+			append32(0);
+			append32(0);
+			append32(65535);
+			append32(1);
+			return true;
+		}
+
+		/**
+		 * writes one TCP session per request
+		 */
+		void write(std::vector<preparedRequest>* requests){
+			for(unsigned long i=0;i<requests->size();i++){
+				writeSession(&requests->at(i));
+			}
+		}
+
+		void close(){
+			if(file!=NULL){
+				flush();
+				fclose(file);
+				file=NULL;
+			}
+		}
+
+		unsigned long sessions=0;
+		unsigned long packets=0;
+
+	private:
+		FILE* file=NULL;
+		std::string buffer;
+		//network byte order
+		uint32_t serverAddress=0;
+		uint16_t serverPort=0;
+		uint64_t timestamp=0;
+
+		enum tcpFlag {FIN=0x01, SYN=0x02, PSH=0x08, ACK=0x10};
+
+		void append16(uint16_t value){
+			buffer.append((const char*)&value,2);
+		}
+
+		void append32(uint32_t value){
+			buffer.append((const char*)&value,4);
+		}
+
+		void flush(){
+			if(!buffer.empty()){
+				fwrite(buffer.data(),1,buffer.size(),file);
+				buffer.clear();
+			}
+		}
+
+		static uint32_t checksumAdd(const unsigned char* data, std::size_t length, uint32_t sum){
+			for(std::size_t i=0;i+1<length;i+=2){
+				sum+=(data[i]<<8)|data[i+1];
+			}
+			if(length%2==1){
+				sum+=data[length-1]<<8;
+			}
+			return sum;
+		}
+
+		static uint16_t checksumFinish(uint32_t sum){
+			while(sum>>16){
+				sum=(sum&0xffff)+(sum>>16);
+			}
+			return htons(~sum&0xffff);
+		}
+
+		/**
+		 * appends one ethernet/IPv4/TCP packet, addresses and ports in network byte order
+		 */
+		void writePacket(uint32_t source, uint16_t sourcePort, uint32_t destination, uint16_t destinationPort,
+				uint32_t sequence, uint32_t acknowledgement, uint8_t flags, const char* payload, std::size_t payloadLength){
+			unsigned char packet[14+20+20];
+			std::size_t length=sizeof(packet)+payloadLength;
+			unsigned char* ip=packet+14;
+			unsigned char* tcp=ip+20;
+			uint16_t value;
+			uint32_t sum;
+			memset(packet,0,sizeof(packet));
+			//ethernet: locally administered dummy MACs, the client side gets 02:..:01
+			packet[0]=0x02;packet[5]=destination==serverAddress?0x02:0x01;
+			packet[6]=0x02;packet[11]=destination==serverAddress?0x01:0x02;
+			packet[12]=0x08;
+			ip[0]=0x45;
+			value=htons(20+20+payloadLength);
+			memcpy(ip+2,&value,2);
+			ip[8]=64;
+			ip[9]=IPPROTO_TCP;
+			memcpy(ip+12,&source,4);
+			memcpy(ip+16,&destination,4);
+			value=checksumFinish(checksumAdd(ip,20,0));
+			memcpy(ip+10,&value,2);
+			memcpy(tcp,&sourcePort,2);
+			memcpy(tcp+2,&destinationPort,2);
+			sequence=htonl(sequence);
+			acknowledgement=htonl(acknowledgement);
+			memcpy(tcp+4,&sequence,4);
+			memcpy(tcp+8,&acknowledgement,4);
+			tcp[12]=5<<4;
+			tcp[13]=flags;
+			value=htons(65535);
+			memcpy(tcp+14,&value,2);
+			//pseudo header, tcp header and payload
+			sum=checksumAdd(ip+12,8,0);
+			sum+=IPPROTO_TCP+20+payloadLength;
+			sum=checksumAdd(tcp,20,sum);
+			sum=checksumAdd((const unsigned char*)payload,payloadLength,sum);
+			value=checksumFinish(sum);
+			memcpy(tcp+16,&value,2);
+
+			append32(timestamp/1000000);
+			append32(timestamp%1000000);
+			append32(length);
+			append32(length);
+			buffer.append((const char*)packet,sizeof(packet));
+			buffer.append(payload,payloadLength);
+			timestamp+=10;
+			packets++;
+			if(buffer.size()>=PCAPBUFFERSIZE){
+				flush();
+			}
+		}
+
+		void writeSession(const preparedRequest* prepared){
+			const std::string& request=prepared->raw;
+			std::string response=expectedResponse(prepared);
+			const std::size_t mss=1460;
+			//client 10.128.0.0/9 plus port 1024-65023 give every session its own 5-tuple
+			uint32_t client=htonl(0x0a800000+1+sessions/64000);
+			uint16_t clientPort=htons(1024+sessions%64000);
+			uint32_t clientSequence=1000;
+			uint32_t serverSequence=5000;
+			writePacket(client,clientPort,serverAddress,serverPort,clientSequence,0,SYN,NULL,0);
+			writePacket(serverAddress,serverPort,client,clientPort,serverSequence,clientSequence+1,SYN|ACK,NULL,0);
+			clientSequence++;
+			serverSequence++;
+			writePacket(client,clientPort,serverAddress,serverPort,clientSequence,serverSequence,ACK,NULL,0);
+			for(std::size_t offset=0;offset<request.size();offset+=mss){
+				std::size_t length=std::min(mss,request.size()-offset);
+				writePacket(client,clientPort,serverAddress,serverPort,clientSequence,serverSequence,PSH|ACK,request.data()+offset,length);
+				clientSequence+=length;
+			}
+			writePacket(serverAddress,serverPort,client,clientPort,serverSequence,clientSequence,ACK,NULL,0);
+			writePacket(serverAddress,serverPort,client,clientPort,serverSequence,clientSequence,PSH|ACK,response.data(),response.size());
+			serverSequence+=response.size();
+			writePacket(client,clientPort,serverAddress,serverPort,clientSequence,serverSequence,ACK,NULL,0);
+			writePacket(client,clientPort,serverAddress,serverPort,clientSequence,serverSequence,FIN|ACK,NULL,0);
+			clientSequence++;
+			writePacket(serverAddress,serverPort,client,clientPort,serverSequence,clientSequence,FIN|ACK,NULL,0);
+			serverSequence++;
+			writePacket(client,clientPort,serverAddress,serverPort,clientSequence,serverSequence,ACK,NULL,0);
+			sessions++;
+		}
+};
+
+/**
+ * built-in HTTP/1.1 responder, so runs can be checked and rules on server responses can be tested without a webserver.
+ * Counts the requests of every rule by their Rulesid header and answers with the status code and reason phrase the rule expects.
+ * One thread serves all connections with epoll, connections are kept open as long as the client keeps them open.
+ */
+class ruleResponder {
+	public:
+		~ruleResponder(){
+			stop();
+		}
+
+		/**
+		 * sets the responses for the sids of the given requests, sids without one get 200 OK. Can be called while serving
+		 */
+		void expect(std::vector<preparedRequest>* requests){
+			std::lock_guard<std::mutex> lock(responsesLock);
+			for(unsigned long i=0;i<requests->size();i++){
+				responses[requests->at(i).sid]=expectedResponse(&requests->at(i));
+			}
+		}
+
+		/**
+		 * listens on the given port of all IPv4 addresses (0 for any free port) and starts serving, returns false on errors
+		 */
+		bool start(int port){
+			struct sockaddr_in address;
+			socklen_t length=sizeof(address);
+			int reuse=1;
+			memset(&address,0,sizeof(address));
+			address.sin_family=AF_INET;
+			address.sin_addr.s_addr=htonl(INADDR_ANY);
+			address.sin_port=htons(port);
+			listenFd=socket(AF_INET,SOCK_STREAM|SOCK_NONBLOCK,0);
+			if(listenFd<0){
+				return false;
+			}
+			setsockopt(listenFd,SOL_SOCKET,SO_REUSEADDR,&reuse,sizeof(reuse));
+			if(bind(listenFd,(struct sockaddr*)&address,sizeof(address))!=0||listen(listenFd,SOMAXCONN)!=0
+					||getsockname(listenFd,(struct sockaddr*)&address,&length)!=0){
+				return false;
+			}
+			boundPort=ntohs(address.sin_port);
+			epollFd=epoll_create1(0);
+			if(epollFd<0){
+				return false;
+			}
+			watch(listenFd,EPOLLIN,EPOLL_CTL_ADD);
+			running=true;
+			server=std::thread(&ruleResponder::serve,this);
+			return true;
+		}
+
+		int port(){
+			return boundPort;
+		}
+
+		void stop(){
+			if(running){
+				running=false;
+				server.join();
+			}
+			for(std::unordered_map<int,responderConnection>::iterator i=connections.begin();i!=connections.end();i++){
+				close(i->first);
+			}
+			connections.clear();
+			if(listenFd>=0){
+				close(listenFd);
+				listenFd=-1;
+			}
+			if(epollFd>=0){
+				close(epollFd);
+				epollFd=-1;
+			}
+		}
+
+		/**
+		 * compares the received requests of every sid with the sent ones and prints lost and duplicated requests.
+		 * Only valid after stop()
+		 */
+		void report(std::unordered_map<std::string,unsigned long>* sent){
+			unsigned long complete=0,lost=0,lostSids=0,duplicated=0,duplicatedSids=0,unexpected=withoutSid;
+			std::vector<std::string> lostList,duplicatedList;
+			for(std::unordered_map<std::string,unsigned long>::iterator i=sent->begin();i!=sent->end();i++){
+				std::unordered_map<std::string,unsigned long>::iterator found=receivedPerSid.find(i->first);
+				unsigned long count=found==receivedPerSid.end()?0:found->second;
+				if(count<i->second){
+					lost+=i->second-count;
+					lostSids++;
+					lostList.push_back(i->first);
+				}else if(count>i->second){
+					duplicated+=count-i->second;
+					duplicatedSids++;
+					duplicatedList.push_back(i->first);
+				}else{
+					complete++;
+				}
+			}
+			for(std::unordered_map<std::string,unsigned long>::iterator i=receivedPerSid.begin();i!=receivedPerSid.end();i++){
+				if(sent->find(i->first)==sent->end()){
+					unexpected+=i->second;
+				}
+			}
+			fprintf(stdout,"Responder: received %lu requests, %lu of %lu sids complete, %lu requests lost (%lu sids), %lu duplicated (%lu sids), %lu without a known sid\n",
+					received,complete,(unsigned long)sent->size(),lost,lostSids,duplicated,duplicatedSids,unexpected);
+			printSids("lost",&lostList);
+			printSids("duplicated",&duplicatedList);
+		}
+
+		unsigned long received=0;
+
+	private:
+		class responderConnection {
+			public:
+				std::string input;
+				//responses the socket did not take yet
+				std::string output;
+				bool waitingForOutput=false;
+		};
+
+		int listenFd=-1;
+		int epollFd=-1;
+		int boundPort=0;
+		std::atomic<bool> running{false};
+		std::thread server;
+		std::unordered_map<int,responderConnection> connections;
+		std::mutex responsesLock;
+		std::unordered_map<std::string,std::string> responses;
+		std::unordered_map<std::string,unsigned long> receivedPerSid;
+		unsigned long withoutSid=0;
+
+		void watch(int fd, uint32_t events, int operation){
+			struct epoll_event event;
+			event.events=events;
+			event.data.fd=fd;
+			epoll_ctl(epollFd,operation,fd,&event);
+		}
+
+		/**
+		 * prints the sids of a list, only the first ones unless verbose
+		 */
+		void printSids(const char* name, std::vector<std::string>* sids){
+			if(sids->empty()){
+				return;
+			}
+			std::sort(sids->begin(),sids->end());
+			fprintf(stdout,"Responder: %s sids:",name);
+			for(unsigned long i=0;i<sids->size()&&(verbose||i<10);i++){
+				fprintf(stdout," %s",sids->at(i).c_str());
+			}
+			fprintf(stdout,"%s\n",!verbose&&sids->size()>10?" ...":"");
+		}
+
+		void serve(){
+			struct epoll_event events[64];
+			char buffer[65536];
+			while(running){
+				int ready=epoll_wait(epollFd,events,64,50);
+				for(int i=0;i<ready;i++){
+					int fd=events[i].data.fd;
+					if(fd==listenFd){
+						int client;
+						while((client=accept4(listenFd,NULL,NULL,SOCK_NONBLOCK))>=0){
+							connections[client];
+							watch(client,EPOLLIN,EPOLL_CTL_ADD);
+						}
+						continue;
+					}
+					responderConnection* connection=&connections[fd];
+					ssize_t length;
+					bool closed=false;
+					while((length=recv(fd,buffer,sizeof(buffer),0))>0){
+						connection->input.append(buffer,length);
+					}
+					if(length==0||(length<0&&errno!=EAGAIN&&errno!=EWOULDBLOCK)){
+						closed=true;
+					}
+					answer(connection);
+					if(!closed&&!flush(fd,connection)){
+						closed=true;
+					}
+					if(closed){
+						epoll_ctl(epollFd,EPOLL_CTL_DEL,fd,NULL);
+						close(fd);
+						connections.erase(fd);
+					}
+				}
+			}
+		}
+
+		/**
+		 * counts all complete requests received on the connection so far and queues their responses
+		 */
+		void answer(responderConnection* connection){
+			std::string& input=connection->input;
+			std::size_t headerEnd;
+			while((headerEnd=input.find("\r\n\r\n"))!=std::string::npos){
+				unsigned long bodyLength=0;
+				//header names are case insensitive
+				std::string header=input.substr(0,headerEnd+2);
+				std::transform(header.begin(),header.end(),header.begin(),::tolower);
+				std::size_t position=header.find("\r\ncontent-length:");
+				if(position!=std::string::npos){
+					bodyLength=strtoul(header.c_str()+position+17,NULL,10);
+				}
+				if(input.size()<headerEnd+4+bodyLength){
+					break;
+				}
+				received++;
+				position=header.find("\r\nrulesid:");
+				if(position!=std::string::npos){
+					position+=10;
+					std::size_t end=header.find("\r\n",position);
+					std::string sid=input.substr(position,end-position);
+					sid.erase(0,sid.find_first_not_of(" \t"));
+					sid.erase(sid.find_last_not_of(" \t")+1);
+					receivedPerSid[sid]++;
+					std::lock_guard<std::mutex> lock(responsesLock);
+					std::unordered_map<std::string,std::string>::iterator response=responses.find(sid);
+					if(response!=responses.end()){
+						connection->output+=response->second;
+						input.erase(0,headerEnd+4+bodyLength);
+						continue;
+					}
+				}else{
+					withoutSid++;
+				}
+				connection->output+="HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+				input.erase(0,headerEnd+4+bodyLength);
+			}
+		}
+
+		/**
+		 * writes queued responses, waits for the socket to become writable if it does not take all. Returns false if the connection broke
+		 */
+		bool flush(int fd, responderConnection* connection){
+			if(connection->output.empty()){
+				return true;
+			}
+			ssize_t written=::send(fd,connection->output.data(),connection->output.size(),MSG_NOSIGNAL);
+			if(written<0&&errno!=EAGAIN&&errno!=EWOULDBLOCK){
+				return false;
+			}
+			connection->output.erase(0,std::max(written,(ssize_t)0));
+			if(connection->output.empty()==connection->waitingForOutput){
+				connection->waitingForOutput=!connection->output.empty();
+				watch(fd,connection->waitingForOutput?EPOLLIN|EPOLLOUT:EPOLLIN,EPOLL_CTL_MOD);
+			}
+			return true;
+		}
+};
+
+/**
+ * true if the rule with the given sid is in shard index of count shards, rules are assigned by the hash of their sid so every run
+ * splits a rule file the same way. stride skips the shards taken by an outer split: the workers of shard i/N split the hashes
+ * that are left after dividing by N
+ */
+bool inShard(const std::string& sid, unsigned long index, unsigned long count, unsigned long stride){
+	return (hashBytes(sid.data(),sid.size())/stride)%count==index;
+}
+
+/**
+ * keeps the rules of one shard of count shards, see inShard()
+ */
+void selectShard(std::vector<snortRule>* rules, unsigned long index, unsigned long count, unsigned long stride){
+	std::vector<snortRule> selected;
+	for(unsigned long i=0;i<rules->size();i++){
+		if(inShard(rules->at(i).body.sid,index,count,stride)){
+			selected.push_back(std::move(rules->at(i)));
+		}
+	}
+	rules->swap(selected);
+}
+
+/**
+ * forks worker processes that send a shard of the rules each, with their own connections.
+ * The coordinator waits for them and merges the statistics every worker writes to its pipe at the end into one report.
+ */
+class workerProcesses {
+	public:
+		/**
+		 * forks count workers, returns the index of the worker in a worker process and -1 in the coordinator
+		 */
+		int start(int count){
+			//stdout is unbuffered, stderr too, but everything else buffered would be written by every worker again
+			fflush(NULL);
+			for(int i=0;i<count;i++){
+				int fds[2];
+				if(pipe(fds)!=0){
+					fprintf(stderr,"Could not create pipe for worker %d: %s. Aborting!\n",i,strerror(errno));
+					exit(1);
+				}
+				pid_t pid=fork();
+				if(pid<0){
+					fprintf(stderr,"Could not fork worker %d: %s. Aborting!\n",i,strerror(errno));
+					exit(1);
+				}
+				if(pid==0){
+					close(fds[0]);
+					for(unsigned long j=0;j<reportFds.size();j++){
+						close(reportFds[j]);
+					}
+					reportFds.clear();
+					pids.clear();
+					reportFd=fds[1];
+					return i;
+				}
+				close(fds[1]);
+				pids.push_back(pid);
+				reportFds.push_back(fds[0]);
+			}
+			return -1;
+		}
+
+		/**
+		 * in a worker: writes the counters and statistics of the worker to the coordinator and exits
+		 */
+		void finishWorker(){
+			FILE* out=fdopen(reportFd,"w");
+			if(out!=NULL){
+				fprintf(out,"requests %lu %lu\n",finishedRequests,failedRequests);
+				statistics.writeReport(out);
+				fclose(out);
+			}
+			exit(0);
+		}
+
+		/**
+		 * in the coordinator: waits for all workers and merges their reports into the global statistics and counters.
+		 * Returns false if a worker did not finish its report
+		 */
+		bool collect(){
+			bool complete=true;
+			for(unsigned long i=0;i<pids.size();i++){
+				unsigned long finished=0,failed=0;
+				int status;
+				FILE* in=fdopen(reportFds[i],"r");
+				bool reported=in!=NULL&&fscanf(in,"requests %lu %lu",&finished,&failed)==2&&statistics.readReport(in);
+				if(in!=NULL){
+					fclose(in);
+				}
+				waitpid(pids[i],&status,0);
+				if(!reported||!WIFEXITED(status)||WEXITSTATUS(status)!=0){
+					fprintf(stderr,"Worker %lu (pid %d) failed, its requests are missing in the report\n",i,(int)pids[i]);
+					complete=false;
+					continue;
+				}
+				fprintf(stdout,"Worker %lu: %lu requests, %lu failed\n",i,finished,failed);
+				finishedRequests+=finished;
+				failedRequests+=failed;
+			}
+			return complete;
+		}
+
+	private:
+		std::vector<pid_t> pids;
+		std::vector<int> reportFds;
+		int reportFd=-1;
+};
+
+/**
+ * queue between two threads of the streaming pipeline, push blocks while it holds capacity items.
+ * Once closed, pushes fail and pops hand out what is left, so either side can end the pipeline
+ */
+template<class T>
+class boundedQueue {
+	public:
+		boundedQueue(std::size_t maxItems):capacity(maxItems){
+		}
+
+		/**
+		 * waits for space and adds the item, returns false if the queue was closed
+		 */
+		bool push(T&& item){
+			std::unique_lock<std::mutex> lock(itemsLock);
+			notFull.wait(lock,[this](){return closed||items.size()<capacity;});
+			if(closed){
+				return false;
+			}
+			items.push_back(std::move(item));
+			notEmpty.notify_one();
+			return true;
+		}
+
+		/**
+		 * waits for at least one item and moves up to maxItems of them to the end of popped, returns false if the queue is closed and empty
+		 */
+		bool pop(std::vector<T>* popped, std::size_t maxItems){
+			std::unique_lock<std::mutex> lock(itemsLock);
+			notEmpty.wait(lock,[this](){return closed||!items.empty();});
+			if(items.empty()){
+				return false;
+			}
+			for(std::size_t i=0;i<maxItems&&!items.empty();i++){
+				popped->push_back(std::move(items.front()));
+				items.pop_front();
+			}
+			notFull.notify_all();
+			return true;
+		}
+
+		void close(){
+			std::lock_guard<std::mutex> lock(itemsLock);
+			closed=true;
+			notFull.notify_all();
+			notEmpty.notify_all();
+		}
+
+	private:
+		std::size_t capacity;
+		std::deque<T> items;
+		bool closed=false;
+		std::mutex itemsLock;
+		std::condition_variable notFull;
+		std::condition_variable notEmpty;
+};
+
+/**
+ * parses, prepares and hands out the rules of a rule file while they are sent (--stream): a parser thread feeds parsed rules
+ * to a thread preparing their requests, the sender takes the requests from it. Queues between the stages are bounded,
+ * so memory does not depend on the size of the rule file and the first request is sent right after the first lines are parsed.
+ * Every rule is dropped as soon as its requests are prepared.
+ */
+class rulePipeline {
+	public:
+		bool printRules=false;
+		//count the lines in lineStatistics, only once when the file is streamed several times
+		bool countLines=false;
+		//rules parsed from the file and rules of the selected shards, valid after finish()
+		unsigned long parsedRules=0;
+		unsigned long selectedRules=0;
+		//set if a rule could not be parsed or sent and the run has to end, the stages stop and next() returns false
+		std::atomic<bool> failed{false};
+
+		rulePipeline():rules(STREAMQUEUEDEPTH),requests(STREAMQUEUEDEPTH){
+		}
+
+		~rulePipeline(){
+			finish();
+		}
+
+		/**
+		 * only rules in shard index of count are sent, see selectShard(). Shards given one after the other narrow the selection
+		 */
+		void addShard(unsigned long index, unsigned long count, unsigned long stride){
+			shards.push_back({index,count,stride});
+		}
+
+		/**
+		 * starts parsing the file from its beginning and preparing the requests for the given host
+		 */
+		void start(mappedFile* file, std::string host, int parseThreads){
+			file->rewind();
+			parser=std::thread(&rulePipeline::parse,this,file,parseThreads);
+			preparer=std::thread(&rulePipeline::prepare,this,host);
+		}
+
+		/**
+		 * replaces batch with the next prepared requests in file order, waits for at least one. Returns false when all are sent
+		 */
+		bool next(std::vector<preparedRequest>* batch){
+			batch->clear();
+			return !failed&&requests.pop(batch,STREAMBATCHSIZE);
+		}
+
+		/**
+		 * stops the pipeline, even if not all requests were taken (e.g. at the end of a soak run), and waits for its threads
+		 */
+		void finish(){
+			rules.close();
+			requests.close();
+			if(parser.joinable()){
+				parser.join();
+			}
+			if(preparer.joinable()){
+				preparer.join();
+			}
+		}
+
+	private:
+		class shard {
+			public:
+				unsigned long index;
+				unsigned long count;
+				unsigned long stride;
+		};
+		std::vector<shard> shards;
+		boundedQueue<snortRule> rules;
+		boundedQueue<preparedRequest> requests;
+		std::thread parser;
+		std::thread preparer;
+
+		/**
+		 * ends the pipeline from one of its threads, the main thread ends the run after finish()
+		 */
+		void fail(){
+			failed=true;
+			rules.close();
+			requests.close();
+		}
+
+		/**
+		 * parses the file batch by batch like the parser of the whole file, but starts with small batches so the first rules are ready at once
+		 */
+		void parse(mappedFile* file, int parseThreads){
+			std::string_view contents=file->data();
+			std::size_t position=0;
+			std::size_t batchSize=PARSECHUNKSIZE;
+			int linecounter=0;
+			std::vector<std::string_view> lines;
+			std::vector<parsedLine> results;
+			while(position<contents.size()){
+				lines.clear();
+				while(lines.size()<batchSize&&position<contents.size()){
+					std::size_t end=contents.find('\n',position);
+					if(end==std::string_view::npos){
+						end=contents.size();
+					}
+					lines.push_back(contents.substr(position,end-position));
+					position=end+1;
+				}
+				parseRuleLines(&lines,linecounter+1,&results,parseThreads);
+				for(unsigned long i=0;i<results.size();i++){
+					results[i].context.flush();
+					if(results[i].context.fatal){
+						fail();
+						return;
+					}
+					if(countLines){
+						lineStatistics.add(&results[i]);
+					}
+					if(!results[i].pushRule){
+						continue;
+					}
+					parsedRules++;
+					if(!selected(results[i].rule.body.sid)){
+						continue;
+					}
+					selectedRules++;
+					if(!rules.push(std::move(results[i].rule))){
+						//the sender stopped
+						return;
+					}
+				}
+				linecounter+=lines.size();
+				file->release(std::min(position,contents.size()));
+				batchSize=std::min(batchSize*2,(std::size_t)PARSEBATCHSIZE);
+			}
+			rules.close();
+		}
+
+		bool selected(const std::string& sid){
+			for(unsigned long i=0;i<shards.size();i++){
+				if(!inShard(sid,shards[i].index,shards[i].count,shards[i].stride)){
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/**
+		 * prepares the requests of every parsed rule, all variants of a rule follow each other like with prepareRulePackets()
+		 */
+		void prepare(std::string host){
+			std::vector<snortRule> batch;
+			while(rules.pop(&batch,STREAMBATCHSIZE)){
+				for(unsigned long i=0;i<batch.size();i++){
+					unsigned long variants=1;
+					if(printRules){
+						printSnortRule(&batch[i]);
+					}
+					for(unsigned long variant=0;variant<variants;variant++){
+						preparedRequest request;
+						variants=prepareRulePacket(&batch[i],host,&request,variant);
+						if(variants==0){
+							fail();
+							return;
+						}
+						if(!requests.push(std::move(request))){
+							return;
+						}
+					}
+					//variants are generated the same way again if another rule has the same pcre, they must not pile up
+					pcreVariants.clear();
+				}
+				batch.clear();
+			}
+			requests.close();
+		}
+};
+
+//set by SIGINT and SIGTERM, stops the standalone responder
+volatile sig_atomic_t stopRequested=0;
+
+void requestStop(int){
+	stopRequested=1;
+}
+
+/**
+ * watches the rule file for edits (--watch) and finds the rules that changed since the last look.
+ * Lines are compared by content, so only added or edited lines are parsed again and moved lines are not sent again.
+ * The directory is watched instead of the file, editors that save by renaming a new file over the old one are noticed as well.
+ */
+class ruleFileWatcher {
+	public:
+		//rules of the added or edited lines of the last change
+		std::vector<snortRule> changedRules;
+		unsigned long addedLines=0;
+		unsigned long removedLines=0;
+
+		~ruleFileWatcher(){
+			if(inotifyFd>=0){
+				close(inotifyFd);
+			}
+		}
+
+		/**
+		 * starts watching the given file, returns false if inotify fails
+		 */
+		bool start(std::string fileName){
+			std::size_t slash=fileName.rfind('/');
+			std::string directory=".";
+			name=fileName;
+			path=fileName;
+			if(slash!=std::string::npos){
+				directory=slash==0?"/":fileName.substr(0,slash);
+				name=fileName.substr(slash+1);
+			}
+			inotifyFd=inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+			if(inotifyFd<0){
+				return false;
+			}
+			return inotify_add_watch(inotifyFd,directory.c_str(),IN_CLOSE_WRITE|IN_MOVED_TO)>=0;
+		}
 
+		/**
+		 * takes the given file contents as the state changes are compared against
+		 */
+		void remember(std::string_view contents){
+			knownLines.clear();
+			forEachLine(contents,[this](std::string_view line, int){
+				knownLine& known=knownLines[hashBytes(line.data(),line.size())];
+				if(known.count++==0){
+					sidOf(line,&known.sid,&known.rev);
 				}
+			});
+		}
 
-				//search for unsupported quantifiers and warn
-				if(pcreString.find("?+")!=std::string::npos||pcreString.find("??")!=std::string::npos||pcreString.find("*+")!=std::string::npos
-						||pcreString.find("++")!=std::string::npos
-				){
-					fprintf(stderr,"WARNING: The pcre in this rule contains one of the not supported quantifiers: ?+, ??, *+, ++. sid:%s\n",rule->body.sid.c_str());
-
+		/**
+		 * waits until the rule file was written and no further writes followed for a moment, returns false if the run is stopped
+		 */
+		bool wait(){
+			struct pollfd pollFd;
+			pollFd.fd=inotifyFd;
+			pollFd.events=POLLIN;
+			bool changed=false;
+			while(!stopRequested){
+				//editors often write a file in several steps, the change is handled once they are done
+				int ready=poll(&pollFd,1,changed?WATCHSETTLEMILLISECONDS:200);
+				if(ready<0&&errno!=EINTR){
+					fprintf(stderr,"Could not watch rule file %s: %s\n",path.c_str(),strerror(errno));
+					return false;
 				}
-
-				//quote it, if not shell will expand this to nasty stuff
-				pcreString="\""+pcreString+"\"";
-				//is it ok if whitespaces occur in uri pcres? -->yes it seems so...
-				if((pcreString.find(' ')!=std::string::npos)&&(rule->body.contentModifierHTTP.at(rule->body.content.size()+k)!=2)){
-					fprintf(stderr,"WARNING: non-encoded whitespace in non-uri pcre in rule with sid:%s. Could lead to problems with pcre generation engine.\n",rule->body.sid.c_str());
+				if(ready>0){
+					changed|=readEvents();
+				}else if(ready==0&&changed){
+					return true;
 				}
-				//go!
-				pcrePayload=generateStringFromPCRE(pcreString);
+			}
+			return false;
+		}
 
-				if(pcrePayload==""){
-					fprintf(stderr,"WARNING: pcre engine produced empty pcre for pcre:%s, rule sid:%s\n",pcreString.c_str(),rule->body.sid.c_str());
+		/**
+		 * reads the rule file again and parses the lines that are not in the remembered state, the result is in changedRules.
+		 * Parser messages are printed as usual, but errors only skip the rule, so a half edited rule does not stop the run.
+		 * Returns false if the file can not be read
+		 */
+		bool update(){
+			mappedFile file;
+			std::unordered_map<uint64_t,knownLine> lines;
+			std::unordered_map<std::string,std::string> removedSids;
+			std::unordered_set<std::string> sentSids;
+			changedRules.clear();
+			addedLines=0;
+			removedLines=0;
+			if(!file.open(path)){
+				return false;
+			}
+			forEachLine(file.data(),[&](std::string_view line, int linenumber){
+				uint64_t hash=hashBytes(line.data(),line.size());
+				knownLine& known=lines[hash];
+				std::unordered_map<uint64_t,knownLine>::iterator old=knownLines.find(hash);
+				if(known.count==0){
+					if(old!=knownLines.end()){
+						known.sid=old->second.sid;
+						known.rev=old->second.rev;
+					}else{
+						sidOf(line,&known.sid,&known.rev);
+					}
 				}
-				//strange newlines are introduced, remove them
-				pcrePayload.erase(std::remove(pcrePayload.begin(), pcrePayload.end(), '\n'), pcrePayload.end());
-				pcrePayload.erase(std::remove(pcrePayload.begin(), pcrePayload.end(), '\r'), pcrePayload.end());
-				//libcurl does not like # sign, remove it:
-				pcrePayload.erase(std::remove(pcrePayload.begin(), pcrePayload.end(), '#'), pcrePayload.end());
+				known.count++;
+				//unchanged as long as the old file had this line as often
+				if(old!=knownLines.end()&&old->second.count>0){
+					old->second.count--;
+					return;
+				}
+				addedLines++;
+				parsedLine result;
+				result.context.linenumber=linenumber;
+				result.pushRule=parseRuleLine(line,&result.context,&result.rule);
+				result.context.flush();
+				if(result.context.fatal){
+					fprintf(stderr,"Rule in line %d not sent, fix it and save again\n",linenumber);
+				}else if(result.pushRule){
+					sentSids.insert(result.rule.body.sid);
+					changedRules.push_back(std::move(result.rule));
+				}
+			});
+			//whatever is left of the old file was edited or deleted
+			for(std::unordered_map<uint64_t,knownLine>::iterator i=knownLines.begin();i!=knownLines.end();i++){
+				removedLines+=i->second.count;
+				if(i->second.count>0&&i->second.sid!=""){
+					removedSids[i->second.sid]=i->second.rev;
+				}
+			}
+			for(unsigned long i=0;i<changedRules.size();i++){
+				const ruleBody& body=changedRules[i].body;
+				std::unordered_map<std::string,std::string>::iterator old=removedSids.find(body.sid);
+				if(old==removedSids.end()){
+					fprintf(stdout,"Rule sid:%s rev:%s added\n",body.sid.c_str(),body.rev.c_str());
+				}else if(old->second!=body.rev){
+					fprintf(stdout,"Rule sid:%s changed from rev:%s to rev:%s\n",body.sid.c_str(),old->second.c_str(),body.rev.c_str());
+				}else{
+					fprintf(stdout,"Rule sid:%s changed without new rev (rev:%s)\n",body.sid.c_str(),body.rev.c_str());
+				}
+			}
+			for(std::unordered_map<std::string,std::string>::iterator i=removedSids.begin();i!=removedSids.end();i++){
+				if(sentSids.count(i->first)==0){
+					fprintf(stdout,"Rule sid:%s rev:%s removed or not accepted anymore\n",i->first.c_str(),i->second.c_str());
+				}
+			}
+			knownLines.swap(lines);
+			return true;
+		}
 
+	private:
+		class knownLine {
+			public:
+				unsigned long count=0;
+				//of rules only
+				std::string sid;
+				std::string rev;
+		};
+		//hash of the line content of every line of the rule file
+		std::unordered_map<uint64_t,knownLine> knownLines;
+		int inotifyFd=-1;
+		std::string path;
+		std::string name;
 
-				switch(rule->body.contentModifierHTTP.at(rule->body.content.size()+k)){
-					case 1:{//http_method
-						if(pcrePayload=="GET"){
-							curl_easy_setopt(handle, CURLOPT_HTTPGET, 1L);
-						}else if(pcrePayload=="POST"){
-							curl_easy_setopt(handle, CURLOPT_POST, 1L);
-						//for everything else use the given method string
-						}else{
-							curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, pcrePayload.c_str());
-						}
-						break;
-					}
-					case 2://http_uri
-					case 3://http_raw_uri
-							{
+		template<class F>
+		void forEachLine(std::string_view contents, F function){
+			std::size_t position=0;
+			int linenumber=1;
+			while(position<contents.size()){
+				std::size_t end=contents.find('\n',position);
+				if(end==std::string_view::npos){
+					end=contents.size();
+				}
+				function(contents.substr(position,end-position),linenumber++);
+				position=end+1;
+			}
+		}
 
-								if(pcrePayload.find("//")!=std::string::npos){
-								fprintf(stderr,"WARNING: The pcre HTTP uri used for this rule contains multiple slashes. Make sure that your IDS config does not normalize them. sid: %s\n",rule->body.sid.c_str());
-								}
-							    //check for whitespace, if at least one found, replace them all with +, which is http conform and  while ' ' in uri is not...
-								for(uint32_t i=0;i<pcrePayload.length();i++){
-									if(pcrePayload.at(i)==' '){
-										std::replace( pcrePayload.begin(), pcrePayload.end(), ' ', '+');
-									}
-								}
-								//this might lead to multiple slashes, but it should not make a difference for detection.
-								hostUri=hostUri+pcrePayload;
-							break;
-					}
-					case 6://header
-					case 7://raw_header
-							{
-							header=curl_slist_append(header, sanitizeHeader(pcrePayload,rule->body.sid).c_str());
-							break;
-					}
-					case 4://http_stat_msg
-					case 5://http_stat_code
-							{fprintf(stderr,"Error: can not control server responses, please remove this rule (sid: %s)\n",rule->body.sid.c_str());
-							if(continueOnError==0){
-								exit(0);
-							}
-							exit(0);
-							break;
-					}
-					case 8://client_body. This possibly adds a body also to GET requests, which is not illegal but useless because server is not allowed to interpret it.
-							//it is not useless for our purposes!!
-							{clientBody=clientBody+pcrePayload;
-							break;
-					}
-					case 9://cookie
-					case 10://raw_cookie
-							{//this way it only copies the value from the rule, meaning it might not always result in a name=value pair.
-							 //this is still legal and accepted by servers.
-								cookies=cookies+pcrePayload;
-							break;
-					}
-					default:{
-							fprintf(stderr,"PCRE content modifier unsupported! Aborting");
-							exit(0);
+		/**
+		 * sid and rev of a rule line without parsing it, empty for comments and lines without sid
+		 */
+		void sidOf(std::string_view line, std::string* sid, std::string* rev){
+			std::vector<ruleOption> options;
+			ruleOption* option;
+			if(line.substr(0,1)=="#"||!tokenizeRuleBody(line,&options)){
+				return;
+			}
+			option=findRuleOption(&options,"sid");
+			if(option!=NULL){
+				*sid=option->value;
+				option=findRuleOption(&options,"rev");
+				if(option!=NULL){
+					*rev=option->value;
+				}
+			}
+		}
+
+		/**
+		 * reads all pending events, returns true if one was about the rule file
+		 */
+		bool readEvents(){
+			char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+			ssize_t length;
+			bool changed=false;
+			while((length=read(inotifyFd,buffer,sizeof(buffer)))>0){
+				for(char* position=buffer;position<buffer+length;position+=sizeof(struct inotify_event)+((struct inotify_event*)position)->len){
+					struct inotify_event* event=(struct inotify_event*)position;
+					if(event->len>0&&name==event->name){
+						changed=true;
 					}
-				}//switch
-			//}
-    	}
-    }
-    //check uri for unsafe and unwise characters rfc-1738, rfc-2396
-    // * Hmm, this should probably be done during parsing, and not before sending...
-    checkUri(hostUri,rule->body.sid.c_str());
-    if(hostUri!=""){
-		//put one slash at beginning if there is none
-		if(hostUri.at(0)!='/'){
-			hostUri.insert(0,"/");
+				}
+			}
+			return changed;
 		}
-    }
-    //prepend host to uri as libcurl does not
-    hostUri.insert(0,host);
-    //set cookies
-    if(cookies!=""){
-    	curl_easy_setopt(handle, CURLOPT_COOKIE, cookies.c_str());
-    }
-	std::string content="Rulesid: ";
-	content=content+rule->body.sid.c_str();
-	//add custom headers from above NOTE: do not append crlf at the end, is done automatically
-	header=curl_slist_append(header, content.c_str());
-	//set custom set of headers from list above
-	curl_easy_setopt(handle, CURLOPT_HTTPHEADER, header);
-    //tell curl which host and uri to use
-    curl_easy_setopt(handle, CURLOPT_URL, hostUri.c_str());
-    //add client body, if set
-    if(clientBody!="12345"){
-    	curl_easy_setopt(handle, CURLOPT_POSTFIELDS, clientBody.c_str());
-    }
-    if(verbose){
-    	curl_easy_setopt(handle, CURLOPT_VERBOSE, 1L);
-    }
-    //set request timeout in secs
-    curl_easy_setopt(handle, CURLOPT_TIMEOUT, 3);
-    //do it!
-	result=curl_easy_perform(handle);
-	if(result != CURLE_OK){
-			fprintf(stderr, "curl_easy_perform() failed for packet from rule sid %s, with url %s, with error: %s.\n",rule->body.sid.c_str(),hostUri.c_str(), curl_easy_strerror(result));
-	}
-	//curl_easy_getinfo (handle, CURLINFO_RESPONSE_CODE, &httpResponseCode);
-	long usedPort;
-	result = curl_easy_getinfo(handle, CURLINFO_LOCAL_PORT, &usedPort);
-	if(result==CURLE_OK) {
-		printf("Local port used for this request: %ld\n", usedPort);
-	}else{
-		printf("Failure in getting local port\n");
-	}
-	curl_easy_cleanup(handle);
-	packetCounter++;
-}
+};
+
+//values of options that only have a long form
+enum longOnlyOption {OPTION_SEED=1000, OPTION_PCRECACHE, OPTION_RATE, OPTION_RAMP, OPTION_STEPS, OPTION_RULECACHE, OPTION_ITERATIONS,
+	OPTION_DURATION, OPTION_REGENERATE, OPTION_REPORTINTERVAL, OPTION_BACKEND, OPTION_PCAP, OPTION_STATSJSON, OPTION_STATSCSV,
+	OPTION_RESPOND, OPTION_RESPONSERULES, OPTION_RESPONSEFILE, OPTION_RESPONSEFORMAT, OPTION_RESPONSEMAX, OPTION_RESPONSEROTATE, OPTION_WORKERS,
+	OPTION_SHARD, OPTION_PCREREWRITES, OPTION_VARIANTS, OPTION_STREAM, OPTION_WATCH, OPTION_SIDS, OPTION_MSG,
+	OPTION_MODIFIER};
 
 /**
  * prints usage message
@@ -1342,38 +5752,91 @@ void usage(std::string progName){
 			<< "Options:\n"
 			<< "\t-f,--file\t\tPath to file with rules\n"
 			<< "\t-h,--help\t\tShow this help message\n"
-			<< "\t-r,--response\t\tPrint response from server (requires -s)\n"
+			<< "\t-r,--response\t\tCapture responses from server (header and body, requires -s), to stdout unless --response-file is set\n"
+			<< "\t--response-file\t\tCapture responses to this file, implies -r\n"
+			<< "\t--response-format\tFormat of captured responses: text (default, a \"--- sid:<sid> status:<code> length:<bytes>\" line before every response)\n"
+			<< "\t\t\t\tor binary (\"" << CAPTUREMAGIC << "\", then per response: uint32 sid length, sid, int32 status, uint64 length,\n"
+			<< "\t\t\t\tuint32 captured length, captured bytes; host byte order)\n"
+			<< "\t--response-max\t\tCapture at most this many bytes of every response (default " << CAPTUREMAXDEFAULT << ")\n"
+			<< "\t--response-rotate\tStart a new capture file <file>.1, <file>.2, ... after this many MB\n"
 			<< "\t-s,--server\t\tSpecify the hostname or ip where crafted packets should be sent to, if not set no packets will be sent\n"
 			<< "\t-p,--print\t\tPrint rules parsed from file\n"
 			<< "\t-v,--verbose\t\tBe verbose when sending packets\n"
 			<< "\t-c,--continue\t\tContinue on errors (also fatal ones). Discouraged, this has undefined behavior!\n"
+			<< "\t-t,--threads\t\tNumber of threads parsing the rule file (default: number of cores)\n"
+			<< "\t-g,--generator\t\tPCRE string generator: native (default, in process) or exrex (external command)\n"
+			<< "\t--seed\t\t\tSeed of the native PCRE string generator (default random, 0 with --pcre-cache)\n"
+			<< "\t--pcre-rewrites\t\tReplace the built-in rewrites of pcres before generation with the ones in this file,\n"
+			<< "\t\t\t\tone \"<pattern><TAB><replacement>\" per line, the first one matching at a position is applied\n"
+			<< "\t--variants\t\tSend up to this many requests with distinct pcre payloads per rule (default 1), generated at once per pcre\n"
+			<< "\t\t\t\tand reproducible: the native generator from --seed, exrex lists the first strings of the pcre\n"
+			<< "\t--pcre-cache\t\tReuse generated PCRE strings from <filename>.pcrecache and add new ones to it\n"
+			<< "\t--rule-cache\t\tLoad the parsed rules from <filename>.rulecache if the rule file did not change, else parse and write it\n"
+			<< "\t\t\t\t(parser warnings are only printed when the rule file is parsed, the rule line statistics are cached)\n"
+			<< "\t--sids\t\t\tOnly parse and send these sids: <sid>|<first>-<last>[,...] or @<file> with one list per line\n"
+			<< "\t--msg\t\t\tOnly parse and send rules whose msg contains this\n"
+			<< "\t--modifier\t\tOnly parse and send rules with a content or pcre for this http modifier, e.g. http_uri, can be given more than once.\n"
+			<< "\t\t\t\tSelections find their rules in <filename>.ruleindex (sid, rev, msg and line of every rule), written if missing or stale\n"
+			<< "\t--stream\t\tParse, prepare and send the rules at the same time instead of one after the other, memory does not grow\n"
+			<< "\t\t\t\twith the rule file. Every soak iteration reads the file again, -p prints the rules while sending\n"
+			<< "\t-n,--concurrency\tNumber of requests in flight at the same time (default 1, one blocking request after the other)\n"
+			<< "\t--workers\t\tSend with this many processes, each sends its own part of the rules with its own connections,\n"
+			<< "\t\t\t\t-n is per process, the rate is split among them. Statistics are merged into one report\n"
+			<< "\t--shard\t\t\tOnly use part i of N of the rules: <i>/<N> with i from 0 to N-1, rules are split by the hash of their sid,\n"
+			<< "\t\t\t\tso several load generators with the same rule file and N send every rule exactly once\n"
+			<< "\t--backend\t\tHow requests are sent: curl (default) or raw (byte exact HTTP/1.1 over plain sockets, http only)\n"
+			<< "\t--stats-json\t\tWrite latency histograms (overall and per http modifier), status codes and errors of all requests as JSON to this file\n"
+			<< "\t--stats-csv\t\tWrite status, error and timings of every single request as CSV to this file\n"
+			<< "\t--respond\t\tRun the built-in responder on this port: counts requests per Rulesid, answers with the status the rule expects\n"
+			<< "\t\t\t\tand reports lost and duplicated requests. With -s it runs while sending (e.g. -s http://127.0.0.1:<port>),\n"
+			<< "\t\t\t\twithout until Ctrl-C or --duration, expecting every rule --iterations times (default once)\n"
+			<< "\t--response-rules\tAccept rules on server responses (http_stat_code, http_stat_msg, to_client) to send them to a built-in\n"
+			<< "\t\t\t\tresponder in another process, implied by --respond\n"
+			<< "\t--watch\t\t\tAfter sending, keep watching the rule file and send the rules of added or edited lines whenever it is saved,\n"
+			<< "\t\t\t\tuntil Ctrl-C (needs -s)\n"
+			<< "\t--pcap\t\t\tWrite the requests as TCP sessions to this pcap file instead of sending them (server from -s or " << PCAPDEFAULTHOST << ")\n"
+			<< "\t--rate\t\t\tSend at a fixed rate: <requests/s>\n"
+			<< "\t--ramp\t\t\tSend at a linearly changing rate: <startRequests/s>:<endRequests/s>:<seconds>\n"
+			<< "\t--steps\t\t\tSend with a step profile: <requests/s>:<seconds>[,<requests/s>:<seconds>...], the last rate is kept\n"
+			<< "\t--iterations\t\tSoak mode: send all rules this many times (0: until --duration is over)\n"
+			<< "\t--duration\t\tSoak mode: send all rules again and again for this many seconds\n"
+			<< "\t--regenerate\t\tSoak mode: generate new PCRE payloads for every iteration (bypasses --pcre-cache)\n"
+			<< "\t--report-interval\tSoak mode: seconds between throughput reports (default " << SOAKREPORTSECONDS << ")\n"
 			<< std::endl;
 }
 
+//the benchmark includes this file and brings its own main
+#ifndef IDSEVENTGENERATOR_NO_MAIN
 int main (int argc, char* argv[]) {
-    std::string line, readFile, host;
+    std::string readFile, host;
     bool ruleFileSet=false;
     bool printRules=false;
     bool sendPackets=false;
-    bool pushRule=true;
+    int concurrency=1;
+    bool seedSet=false;
+    bool usePcreCache=false;
+    bool useRuleCache=false;
+    bool streamRules=false;
+    bool watchRules=false;
+    ruleSelection selection;
+    sendRateLimiter limiter;
+    soakRun soak;
+    std::string pcapFileName;
+    std::string statsJsonFileName;
+    int respondPort=-1;
+    responseCapture capture;
+    std::string responseFileName="-";
+    std::string statsCsvFileName;
+    int workers=1;
+    bool customPcreRewrites=false;
+    unsigned long shardIndex=0;
+    unsigned long shardCount=1;
+    int parseThreads=std::max(1U,std::thread::hardware_concurrency());
 
     int linecounter=0,index=0,iarg=0;
-    snortRule tempRule;
-    std::size_t alertPosition;
-    std::size_t contentPosition;
-    std::size_t pcrePosition;
 
     std::vector<snortRule> parsedRules;
 
-    //hardly any rule will use more than 15 content keywords
-    tempRule.body.content.reserve(VECTORRESERVE);
-    tempRule.body.contentOriginal.reserve(VECTORRESERVE);
-    tempRule.body.containsHex.reserve(VECTORRESERVE);
-    tempRule.body.negatedContent.reserve(VECTORRESERVE);
-    tempRule.body.contentModifierHTTP.reserve(VECTORRESERVE);
-    tempRule.body.pcre.reserve(VECTORRESERVE);
-    tempRule.body.negatedPcre.reserve(VECTORRESERVE);
-    tempRule.body.pcreNocase.reserve(VECTORRESERVE);
     //disable buffering on stdout:
     setbuf(stdout, NULL);
 
@@ -1393,10 +5856,42 @@ int main (int argc, char* argv[]) {
 				{"verbose",  no_argument,    	 0, 'v'},
 				{"continue", no_argument,		 0, 'c'},
     	        {"server",   required_argument,  0, 's'},
+    	        {"concurrency", required_argument, 0, 'n'},
+    	        {"generator", required_argument, 0, 'g'},
+    	        {"threads",  required_argument,  0, 't'},
+    	        {"seed",     required_argument,  0, OPTION_SEED},
+    	        {"pcre-cache", no_argument,      0, OPTION_PCRECACHE},
+    	        {"rate",     required_argument,  0, OPTION_RATE},
+    	        {"ramp",     required_argument,  0, OPTION_RAMP},
+    	        {"steps",    required_argument,  0, OPTION_STEPS},
+    	        {"rule-cache", no_argument,      0, OPTION_RULECACHE},
+    	        {"iterations", required_argument, 0, OPTION_ITERATIONS},
+    	        {"duration", required_argument,  0, OPTION_DURATION},
+    	        {"regenerate", no_argument,      0, OPTION_REGENERATE},
+    	        {"report-interval", required_argument, 0, OPTION_REPORTINTERVAL},
+    	        {"backend",  required_argument,  0, OPTION_BACKEND},
+    	        {"pcap",     required_argument,  0, OPTION_PCAP},
+    	        {"stats-json", required_argument, 0, OPTION_STATSJSON},
+    	        {"stats-csv", required_argument, 0, OPTION_STATSCSV},
+    	        {"respond",  required_argument,  0, OPTION_RESPOND},
+    	        {"response-rules", no_argument,  0, OPTION_RESPONSERULES},
+    	        {"response-file", required_argument, 0, OPTION_RESPONSEFILE},
+    	        {"response-format", required_argument, 0, OPTION_RESPONSEFORMAT},
+    	        {"response-max", required_argument, 0, OPTION_RESPONSEMAX},
+    	        {"response-rotate", required_argument, 0, OPTION_RESPONSEROTATE},
+    	        {"workers",  required_argument,  0, OPTION_WORKERS},
+    	        {"shard",    required_argument,  0, OPTION_SHARD},
+    	        {"pcre-rewrites", required_argument, 0, OPTION_PCREREWRITES},
+    	        {"variants", required_argument,  0, OPTION_VARIANTS},
+    	        {"stream", no_argument,  0, OPTION_STREAM},
+    	        {"watch", no_argument,  0, OPTION_WATCH},
+    	        {"sids", required_argument,  0, OPTION_SIDS},
+    	        {"msg", required_argument,  0, OPTION_MSG},
+    	        {"modifier", required_argument,  0, OPTION_MODIFIER},
     			{"file",     required_argument,  0, 'f'},
     	        {0,			 0,					 0,  0},
     	};
-        iarg = getopt_long_only(argc, argv, "s:f:prhvc", longOptions, &index);
+        iarg = getopt_long_only(argc, argv, "s:f:n:g:t:prhvc", longOptions, &index);
         if (iarg == -1){
             break;}
         switch (iarg){
@@ -1417,7 +5912,33 @@ int main (int argc, char* argv[]) {
     			break;
         	case 'r':
         		printResponse=true;
-        		std::cout << "Configured to print response from server\n";
+        		std::cout << "Configured to capture responses from server\n";
+    			break;
+        	case OPTION_RESPONSEFILE:
+        		printResponse=true;
+        		responseFileName=optarg;
+        		std::cout << "Configured to capture responses from server to: "<< responseFileName <<"\n";
+    			break;
+        	case OPTION_RESPONSEFORMAT:
+        		if(strcmp(optarg,"binary")==0){
+        			capture.format=responseCapture::BINARY;
+        		}else if(strcmp(optarg,"text")!=0){
+        			fprintf(stderr,"Unknown response capture format: %s\n",optarg);
+        			usage(argv[0]);
+        			exit(1);
+        		}
+    			break;
+        	case OPTION_RESPONSEMAX:
+        		capture.maxLength=strtoul(optarg,NULL,10);
+        		std::cout << "Configured to capture at most "<< capture.maxLength <<" bytes of every response\n";
+    			break;
+        	case OPTION_RESPONSEROTATE:
+        		capture.rotateBytes=(uint64_t)(atof(optarg)*1024*1024);
+        		if(capture.rotateBytes==0){
+        			fprintf(stderr,"Rotation size must be positive\n");
+        			usage(argv[0]);
+        			exit(1);
+        		}
     			break;
         	case 'f':
         		readFile=optarg;
@@ -1429,6 +5950,197 @@ int main (int argc, char* argv[]) {
         		sendPackets=true;
         		std::cout << "Configured to send packets to host: "<< host <<"\n";
         		break;
+        	case 'g':
+        		if(std::string(optarg)=="exrex"){
+        			externalPcreGenerator=true;
+        		}else if(std::string(optarg)!="native"){
+        			fprintf(stderr,"Unknown PCRE string generator: %s\n",optarg);
+        			usage(argv[0]);
+        			exit(1);
+        		}
+        		std::cout << "Configured to generate PCRE strings with generator: "<< optarg <<"\n";
+        		break;
+        	case OPTION_SEED:
+        		pcreSeed=strtoul(optarg,NULL,10);
+        		seedSet=true;
+        		std::cout << "Configured to seed PCRE string generation with: "<< pcreSeed <<"\n";
+        		break;
+        	case OPTION_VARIANTS:
+        		payloadVariants=strtoul(optarg,NULL,10);
+        		if(payloadVariants<1){
+        			fprintf(stderr,"Number of variants must be at least 1\n");
+        			usage(argv[0]);
+        			exit(1);
+        		}
+        		std::cout << "Configured to send up to "<< payloadVariants <<" payload variants per rule\n";
+        		break;
+        	case OPTION_PCREREWRITES:
+        		if(!pcreRewrites.load(optarg)){
+        			fprintf(stderr,"Unable to read pcre rewrites from %s\n",optarg);
+        			exit(1);
+        		}
+        		customPcreRewrites=true;
+        		std::cout << "Configured to rewrite pcres with the rewrites from: "<< optarg <<"\n";
+        		break;
+        	case OPTION_PCRECACHE:
+        		usePcreCache=true;
+        		std::cout << "Configured to use PCRE payload cache\n";
+        		break;
+        	case OPTION_RULECACHE:
+        		useRuleCache=true;
+        		std::cout << "Configured to use rule cache\n";
+        		break;
+        	case OPTION_STREAM:
+        		streamRules=true;
+        		std::cout << "Configured to send rules while parsing\n";
+        		break;
+        	case OPTION_WATCH:
+        		watchRules=true;
+        		std::cout << "Configured to watch the rule file for changes\n";
+        		break;
+        	case OPTION_SIDS:
+        		if(!selection.addSids(optarg)){
+        			fprintf(stderr,"Malformed sid list: %s\n",optarg);
+        			usage(argv[0]);
+        			exit(1);
+        		}
+        		std::cout << "Configured to select sids: "<< optarg <<"\n";
+        		break;
+        	case OPTION_MSG:
+        		selection.msg=optarg;
+        		std::cout << "Configured to select rules with msg containing: "<< optarg <<"\n";
+        		break;
+        	case OPTION_MODIFIER:
+        		{
+        			int modifier;
+        			for(modifier=HTTP_NONE+1;modifier<HTTP_MODIFIERCOUNT;modifier++){
+        				if(strcmp(optarg,httpModifierNames[modifier])==0){
+        					break;
+        				}
+        			}
+        			if(modifier==HTTP_MODIFIERCOUNT){
+        				fprintf(stderr,"Unknown http modifier: %s\n",optarg);
+        				usage(argv[0]);
+        				exit(1);
+        			}
+        			selection.modifierMask|=1<<modifier;
+        		}
+        		std::cout << "Configured to select rules with modifier: "<< optarg <<"\n";
+        		break;
+        	case OPTION_BACKEND:
+        		if(strcmp(optarg,"raw")==0){
+        			rawBackend=true;
+        		}else if(strcmp(optarg,"curl")!=0){
+        			fprintf(stderr,"Unknown backend: %s\n",optarg);
+        			usage(argv[0]);
+        			exit(1);
+        		}
+        		std::cout << "Configured to send requests with backend: "<< optarg <<"\n";
+        		break;
+        	case OPTION_STATSJSON:
+        		statsJsonFileName=optarg;
+        		std::cout << "Configured to write request statistics to: "<< statsJsonFileName <<"\n";
+        		break;
+        	case OPTION_STATSCSV:
+        		statsCsvFileName=optarg;
+        		std::cout << "Configured to write per request statistics to: "<< statsCsvFileName <<"\n";
+        		break;
+        	case OPTION_WORKERS:
+        		workers=atoi(optarg);
+        		if(workers<1){
+        			fprintf(stderr,"Number of workers must be at least 1\n");
+        			usage(argv[0]);
+        			exit(1);
+        		}
+        		std::cout << "Configured to send with "<< workers <<" worker processes\n";
+        		break;
+        	case OPTION_SHARD:{
+        		char tail;
+        		if(sscanf(optarg,"%lu/%lu%c",&shardIndex,&shardCount,&tail)!=2||shardCount<1||shardIndex>=shardCount){
+        			fprintf(stderr,"Malformed shard, expected <i>/<N> with 0<=i<N: %s\n",optarg);
+        			usage(argv[0]);
+        			exit(1);
+        		}
+        		std::cout << "Configured to use shard "<< shardIndex << " of " << shardCount <<" of the rules\n";
+        		break;
+        	}
+        	case OPTION_RESPOND:
+        		respondPort=atoi(optarg);
+        		if(respondPort<0||respondPort>65535){
+        			fprintf(stderr,"Invalid responder port: %s\n",optarg);
+        			usage(argv[0]);
+        			exit(1);
+        		}
+        		responseRules=true;
+        		std::cout << "Configured to respond to requests on port: "<< respondPort <<"\n";
+        		break;
+        	case OPTION_RESPONSERULES:
+        		responseRules=true;
+        		std::cout << "Configured to accept rules on server responses\n";
+        		break;
+        	case OPTION_PCAP:
+        		pcapFileName=optarg;
+        		pcapExport=true;
+        		std::cout << "Configured to write packets to pcap file: "<< pcapFileName <<"\n";
+        		break;
+        	case OPTION_ITERATIONS:
+        		soak.iterations=strtoul(optarg,NULL,10);
+        		std::cout << "Configured to send all rules "<< soak.iterations <<" times\n";
+        		break;
+        	case OPTION_DURATION:
+        		soak.duration=atof(optarg);
+        		if(soak.duration<=0){
+        			fprintf(stderr,"Soak duration must be positive\n");
+        			usage(argv[0]);
+        			exit(1);
+        		}
+        		std::cout << "Configured to send rules for "<< soak.duration <<" seconds\n";
+        		break;
+        	case OPTION_REGENERATE:
+        		soak.regenerate=true;
+        		std::cout << "Configured to regenerate PCRE payloads for every iteration\n";
+        		break;
+        	case OPTION_REPORTINTERVAL:
+        		soak.reportInterval=atof(optarg);
+        		if(soak.reportInterval<=0){
+        			fprintf(stderr,"Report interval must be positive\n");
+        			usage(argv[0]);
+        			exit(1);
+        		}
+        		break;
+        	case OPTION_RATE:
+        	case OPTION_RAMP:
+        	case OPTION_STEPS:
+        		if(limiter.limited()){
+        			fprintf(stderr,"Only one of --rate, --ramp and --steps can be used\n");
+        			usage(argv[0]);
+        			exit(1);
+        		}
+        		if(!limiter.configure(iarg==OPTION_RATE?sendRateLimiter::FIXED:(iarg==OPTION_RAMP?sendRateLimiter::RAMP:sendRateLimiter::STEPS),optarg)){
+        			fprintf(stderr,"Malformed rate profile: %s\n",optarg);
+        			usage(argv[0]);
+        			exit(1);
+        		}
+        		std::cout << "Configured to pace requests with profile: "<< optarg <<"\n";
+        		break;
+        	case 't':
+        		parseThreads=atoi(optarg);
+        		if(parseThreads<1){
+        			fprintf(stderr,"Number of parser threads must be at least 1\n");
+        			usage(argv[0]);
+        			exit(1);
+        		}
+        		std::cout << "Configured to parse with "<< parseThreads <<" threads\n";
+        		break;
+        	case 'n':
+        		concurrency=atoi(optarg);
+        		if(concurrency<1){
+        			fprintf(stderr,"Concurrency must be at least 1\n");
+        			usage(argv[0]);
+        			exit(1);
+        		}
+        		std::cout << "Configured to keep "<< concurrency <<" requests in flight\n";
+        		break;
         	case '?':
         		// getopt_long_only returns '?' for an ambiguous match or an extraneous parameter
         		//ignore it
@@ -1445,94 +6157,156 @@ int main (int argc, char* argv[]) {
     	usage(argv[0]);
     	exit(0);
     }
+    if(respondPort>=0&&pcapExport){
+    	fprintf(stderr,"--respond can not be combined with --pcap\n");
+    	usage(argv[0]);
+    	exit(1);
+    }
+    if(streamRules&&((!sendPackets&&!pcapExport)||useRuleCache)){
+    	fprintf(stderr,"--stream needs -s or --pcap and can not be combined with --rule-cache (the cache holds all rules at once)\n");
+    	usage(argv[0]);
+    	exit(1);
+    }
+    if(selection.active()&&(useRuleCache||streamRules||watchRules)){
+    	fprintf(stderr,"--sids, --msg and --modifier can not be combined with --rule-cache, --stream or --watch\n");
+    	usage(argv[0]);
+    	exit(1);
+    }
+    if(watchRules&&(!sendPackets||pcapExport||streamRules||workers>1||soak.enabled())){
+    	fprintf(stderr,"--watch needs -s and can not be combined with --pcap, --stream, --workers or a soak run\n");
+    	usage(argv[0]);
+    	exit(1);
+    }
+    if(workers>1&&(!sendPackets||pcapExport||respondPort>=0)){
+    	fprintf(stderr,"--workers needs -s and can not be combined with --pcap or --respond (run the responder as a process of its own)\n");
+    	usage(argv[0]);
+    	exit(1);
+    }
 
-    std::ifstream ruleFile (readFile.c_str());
-    if (ruleFile.is_open()){
-        //one line is one snort rule
-        while ( getline (ruleFile,line) ){
-        	pushRule=true;
-        	linecounter++;
-            //check if rule is a comment, if yes-> ignore
-            if(line.substr(0,1)!="#"){
-                //check if rule is alert and if it contains content keyword, almost all rules do and if not it is not interesting for us
-                alertPosition=line.substr(0,6).find("alert");
-                contentPosition=line.find("content:");
-                pcrePosition=line.find("pcre:");
-                //sort out rules that we are not interested in
-                if(alertPosition==std::string::npos){
-                    fprintf(stdout,"WARNING: Rule in line number %d, does not contain alert keyword. Ignored\n",linecounter);
-                //the following check inherently also checks for uricontent: keyword
-                }else if((contentPosition==std::string::npos)&&(pcrePosition==std::string::npos)){
-                	fprintf(stdout,"WARNING: Rule in line number %d, does not contain content or pcre keyword. Ignored\n",linecounter);
-            	}else if(line.find("flowbits:")!=std::string::npos||line.find("distance:")!=std::string::npos||line.find("within:")!=std::string::npos||line.find("offset:")!=std::string::npos||line.find("depth:")!=std::string::npos){
-            		fprintf(stdout,"WARNING: Rule in line number %d, contains keyword for byte ranges (flowbits,distance,within,depth,offset) which is not supported. Ignored\n",linecounter);
-            	}else if(line.find("dce_")!=std::string::npos||line.find("threshold:")!=std::string::npos||line.find("urilen:")!=std::string::npos||
-            			line.find("detectionfilter")!=std::string::npos){
-            		fprintf(stdout,"WARNING: Rule in line number %d, contains one of the following not supported keywords: dce_*, threshold:, urilen:, detectionfilter. Ignored\n",linecounter);
-            	}else if(line.find("from_server")!=std::string::npos||line.find("to_client")!=std::string::npos){
-        			fprintf(stdout,"WARNING: Rule looks for packet coming from server ('from_server' or 'to_client' keyword). Can not control server responses. Rule ignored in line: %d\n",linecounter);
-            	}else if(line.find("content: ")!=std::string::npos){
-        			fprintf(stdout,"WARNING: Content pattern does not start immediately after content keyword. I don't like that. Fix it. Rule ignored in line: %d\n",linecounter);
-
-            	}else{
-					//parse sid first, so we can print this info in error msgs
-					parseSid(&line, &linecounter,&tempRule);
-                    parseHeader(&line,&linecounter,&tempRule);
-                    parseMsg(&line,&linecounter,&tempRule);
-
-                    //it might contain no content (just pcre), than skip parseContent
-					if(contentPosition!=std::string::npos){
-						//if uricontent, skip next test because no http_ is intended
-						if(line.substr(contentPosition-3,3)!="uri"){
-							if(line.find("http_")==std::string::npos){
-								fprintf(stdout,"WARNING: Rule in line number %d contains content keyword but no http_ content modifier. Content part ignored\n", linecounter);
-							}
-						}
-						parseContent(&line, &linecounter,&tempRule);
-						parseContentModifier(&line, &linecounter,&tempRule);
-					}
-                    if(pcrePosition!=std::string::npos){
-                        parsePcre(&line, &linecounter,&tempRule);
-                    }
-
-                    //do not allow rules which have no http_ content modifier
-					for (unsigned long i = 0; i < tempRule.body.content.size();i++) {
-						if (tempRule.body.contentModifierHTTP[i] == 0) {
-							pushRule = false;
-							fprintf(stdout,"WARNING: Rule with sid:%s in line number %d, contains at least one content without http_* content modifier. Ignored\n", tempRule.body.sid.c_str(), linecounter);
-						}
-					}
-
-					if(continueOnError==false){
-						//before pushing rule, check if it makes sense. this will exit() if it fails.
-						plausabilityCheck(&tempRule,&linecounter);
-					}
-					if (pushRule) {
-						parsedRules.push_back(tempRule);
-					}
-            	}
-            }
-            tempRule.body.containsHex.clear();
-            tempRule.body.content.clear();
-            tempRule.body.negatedContent.clear();
-            tempRule.body.contentOriginal.clear();
-            tempRule.body.contentModifierHTTP.clear();
-            tempRule.body.contentNocase.clear();
-            tempRule.body.pcre.clear();
-            tempRule.body.negatedPcre.clear();
-            tempRule.body.pcreNocase.clear();
-            tempRule.body.msg.clear();
-            tempRule.body.rev.clear();
-            tempRule.body.sid.clear();
+    //without a fixed seed the cache would never hit
+    if(!seedSet&&!usePcreCache){
+    	std::random_device seedSource;
+    	pcreSeed=seedSource();
+    	if(!externalPcreGenerator){
+    		std::cout << "PCRE payloads are generated with seed " << pcreSeed << ", run with --seed " << pcreSeed << " to send the same payloads again\n";
+    	}
     }
-    ruleFile.close();
-    }else{
+    pcrePayloadCache pcreCache;
+    if(usePcreCache){
+    	pcreCache.load(readFile+".pcrecache");
+    	payloadCache=&pcreCache;
+    }
+
+    mappedFile ruleFile;
+    if(!ruleFile.open(readFile)){
         fprintf(stderr,"Unable to open rule file %s\n", readFile.c_str());
         exit(0);
     }
-    std::cout << parsedRules.size() << " rules successfully parsed\n";
+    //started before parsing, so edits made while the rules are sent the first time are not missed
+    ruleFileWatcher watcher;
+    if(watchRules){
+    	if(!watcher.start(readFile)){
+    		fprintf(stderr,"Unable to watch rule file %s: %s\n",readFile.c_str(),strerror(errno));
+    		exit(1);
+    	}
+    	watcher.remember(ruleFile.data());
+    }
+    uint64_t ruleCacheKey=0;
+    bool ruleCacheHit=false;
+    if(useRuleCache){
+    	ruleCacheKey=compiledRuleCache::key(ruleFile.data());
+    	ruleCacheHit=compiledRuleCache::load(readFile+".rulecache",ruleCacheKey,&parsedRules,&lineStatistics);
+    	if(ruleCacheHit){
+    		std::cout << "Rule file unchanged, rules loaded from rule cache\n";
+    	}
+    }
+    if(selection.active()){
+    	std::string_view contents=ruleFile.data();
+    	std::vector<ruleIndexEntry> index;
+    	std::vector<std::string_view> lines;
+    	std::vector<int> linenumbers;
+    	std::vector<parsedLine> results;
+    	uint64_t indexKey=compiledRuleCache::indexKey(contents);
+    	if(compiledRuleCache::loadIndex(readFile+".ruleindex",indexKey,&index)){
+    		std::cout << "Rule file unchanged, " << index.size() << " rules loaded from rule index\n";
+    	}else{
+    		buildRuleIndex(contents,&index);
+    		compiledRuleCache::saveIndex(readFile+".ruleindex",indexKey,&index);
+    		std::cout << "Rule index of " << index.size() << " rules written to " << readFile << ".ruleindex\n";
+    	}
+    	//only the selected lines go through the parser
+    	for(unsigned long i=0;i<index.size();i++){
+    		if(selection.matches(index[i])){
+    			lines.push_back(contents.substr(index[i].offset,index[i].length));
+    			linenumbers.push_back(index[i].linenumber);
+    		}
+    	}
+    	std::cout << lines.size() << " rules selected from the rule index\n";
+    	parseRuleLines(&lines,0,&results,parseThreads,&linenumbers);
+    	for(unsigned long i=0;i<results.size();i++){
+    		results[i].context.flush();
+    		if(results[i].context.fatal){
+    			exit(1);
+    		}
+    		lineStatistics.add(&results[i]);
+    		if(results[i].pushRule&&selection.matches(results[i].rule)){
+    			parsedRules.push_back(std::move(results[i].rule));
+    		}
+    	}
+    }else if(!ruleCacheHit&&!streamRules){
+    	std::string_view contents=ruleFile.data();
+    	std::size_t position=0;
+    	std::vector<std::string_view> lines;
+    	std::vector<parsedLine> results;
+    	lines.reserve(PARSEBATCHSIZE);
+    	//lines are parsed batch by batch, so memory does not depend on the file size and messages show up while parsing
+    	while(true){
+    		lines.clear();
+    		//one line is one snort rule, lines are slices of the mapped file and never copied
+    		while(lines.size()<PARSEBATCHSIZE&&position<contents.size()){
+    			std::size_t end=contents.find('\n',position);
+    			if(end==std::string_view::npos){
+    				end=contents.size();
+    			}
+    			lines.push_back(contents.substr(position,end-position));
+    			position=end+1;
+    		}
+    		if(lines.empty()){
+    			break;
+    		}
+    		parseRuleLines(&lines,linecounter+1,&results,parseThreads);
+    		//merge in file order
+    		for(unsigned long i=0;i<results.size();i++){
+    			results[i].context.flush();
+    			if(results[i].context.fatal){
+    				exit(1);
+    			}
+    			lineStatistics.add(&results[i]);
+    			if(results[i].pushRule){
+    				parsedRules.push_back(std::move(results[i].rule));
+    			}
+    		}
+    		linecounter+=lines.size();
+    		//parsed rules only hold copies, the lines of this batch are not needed anymore
+    		ruleFile.release(std::min(position,contents.size()));
+    	}
+    	//only a complete parse gets here, fatal errors exit above
+    	if(useRuleCache){
+    		compiledRuleCache::save(readFile+".rulecache",ruleCacheKey,&parsedRules,&lineStatistics);
+    	}
+    }
+    //with --stream the rules are parsed while sending
+    if(!streamRules){
+    	std::cout << parsedRules.size() << " rules successfully parsed\n";
+    	if(shardCount>1){
+    		selectShard(&parsedRules,shardIndex,shardCount,1);
+    		std::cout << parsedRules.size() << " rules in shard " << shardIndex << "/" << shardCount << "\n";
+    	}
+    }
 
-    if(printRules){
+    if(printRules&&streamRules){
+    	std::cout << "Printing rules while sending\n";
+    }else if(printRules){
 		for(unsigned long i=0;i<parsedRules.size();i++){
 			printSnortRule(&parsedRules[i]);
 		}
@@ -1540,14 +6314,269 @@ int main (int argc, char* argv[]) {
     	std::cout << "Not printing rules\n";
     }
 
-    if(sendPackets){
-		for(unsigned long i=0;i<parsedRules.size();i++){
-			sendRulePacket(&parsedRules[i],host,verbose);
-		}
+    if(pcapExport&&!sendPackets){
+    	host=PCAPDEFAULTHOST;
+    }
+    //worker processes are forked after parsing, so the rule file is parsed only once
+    workerProcesses workerPool;
+    int worker=-1;
+    if(workers>1){
+    	statistics.begin();
+    	worker=workerPool.start(workers);
+    	if(worker>=0){
+    		selectShard(&parsedRules,worker,workers,shardCount);
+    		limiter.scale(1.0/workers);
+    		//every worker writes its own files, the coordinator writes the merged statistics
+    		if(responseFileName!="-"){
+    			responseFileName+=".worker"+std::to_string(worker);
+    		}
+    		if(statsCsvFileName!=""){
+    			statsCsvFileName+=".worker"+std::to_string(worker);
+    		}
+    		statsJsonFileName="";
+    		//one write, so lines of the workers do not get mixed up
+    		if(streamRules){
+    			fprintf(stdout,"Worker %d streams its part of the rules\n",worker);
+    		}else{
+    			fprintf(stdout,"Worker %d sends %lu rules\n",worker,(unsigned long)parsedRules.size());
+    		}
+    	}
+    }
+
+    if(workers>1&&worker<0){
+    	//coordinator, the workers do the sending
+    	bool complete=workerPool.collect();
+    	fprintf(stdout,"All workers finished: %lu requests, %lu failed\n",finishedRequests,failedRequests);
+    	if(statsJsonFileName!=""&&!statistics.writeJson(statsJsonFileName)){
+    		fprintf(stderr,"Unable to write statistics file %s\n",statsJsonFileName.c_str());
+    	}
+    	if(!complete){
+    		exit(1);
+    	}
+    }else if(respondPort>=0&&!sendPackets){
+    	//the rules are sent by another process or host, only the expected responses are needed here
+    	std::vector<preparedRequest> requests;
+    	if(!prepareRulePackets(&parsedRules,PCAPDEFAULTHOST,&requests)){
+    		exit(0);
+    	}
+    	ruleResponder responder;
+    	responder.expect(&requests);
+    	if(!responder.start(respondPort)){
+    		fprintf(stderr,"Unable to listen on port %d: %s\n",respondPort,strerror(errno));
+    		exit(1);
+    	}
+    	signal(SIGINT,requestStop);
+    	signal(SIGTERM,requestStop);
+    	std::cout << "Responding on port " << responder.port() << ", stop with Ctrl-C\n";
+    	std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+    	while(!stopRequested&&(soak.duration<=0||std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count()<soak.duration)){
+    		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    	}
+    	responder.stop();
+    	std::unordered_map<std::string,unsigned long> sent;
+    	for(unsigned long i=0;i<requests.size();i++){
+    		sent[requests[i].sid]+=std::max(1UL,soak.iterations);
+    	}
+    	responder.report(&sent);
+    }else if(sendPackets||pcapExport){
+    	//initialize all stuff needed for sending packets with curl, once for the whole run
+    	curl_global_init(CURL_GLOBAL_ALL);
+    	{
+			//all requests are built before the first one is sent, unless they are streamed
+			std::vector<preparedRequest> requests;
+			if(!prepareRulePackets(&parsedRules,host,&requests)){
+				exit(0);
+			}
+			if((verbose||customPcreRewrites)&&!streamRules){
+				pcreRewrites.report();
+			}
+			//only requests with pcre payloads change when they are prepared again
+			std::vector<unsigned long> pcreRequests;
+			for(unsigned long i=0;i<parsedRules.size();i++){
+				for(unsigned long j=0;j<parsedRules[i].body.matches.size();j++){
+					if(parsedRules[i].body.matches[j].has(ruleMatch::PCRE)&&!parsedRules[i].body.matches[j].has(ruleMatch::NEGATED)){
+						pcreRequests.push_back(i);
+						break;
+					}
+				}
+			}
+			curlHandlePool pool;
+			rawHttpSender rawSender(verbose);
+			pcapWriter pcap;
+			if(pcapExport&&!pcap.open(pcapFileName,host)){
+				fprintf(stderr,"Unable to open pcap file %s\n", pcapFileName.c_str());
+				exit(1);
+			}
+			ruleResponder responder;
+			if(respondPort>=0){
+				responder.expect(&requests);
+				if(!responder.start(respondPort)){
+					fprintf(stderr,"Unable to listen on port %d: %s\n",respondPort,strerror(errno));
+					exit(1);
+				}
+				statistics.countSids=true;
+			}
+			if(printResponse&&!pcapExport){
+				if(!capture.open(responseFileName)){
+					fprintf(stderr,"Unable to open response capture file %s\n",responseFileName.c_str());
+					exit(1);
+				}
+				responseSink=&capture;
+			}
+			if(statsCsvFileName!=""&&!statistics.openCsv(statsCsvFileName)){
+				fprintf(stderr,"Unable to open statistics file %s\n",statsCsvFileName.c_str());
+				exit(1);
+			}
+			auto sendRequests=[&](std::vector<preparedRequest>* batch){
+				if(pcapExport){
+					pcap.write(batch);
+				}else if(rawBackend){
+					rawSender.send(batch,concurrency,&limiter,&soak);
+				}else if(concurrency>1){
+					sendRulePacketsConcurrent(batch,verbose,concurrency,&pool,&limiter,&soak);
+				}else{
+					for(unsigned long i=0;i<batch->size()&&!soak.expired();i++){
+						limiter.acquire();
+						sendRulePacket(&batch->at(i),verbose,&pool);
+						soak.report();
+					}
+				}
+			};
+			limiter.begin();
+			soak.begin();
+			statistics.begin();
+			while(soak.nextIteration()){
+				if(streamRules){
+					rulePipeline pipeline;
+					pcrePayloadCache* cache=payloadCache;
+					pipeline.printRules=printRules&&soak.currentIteration()==1;
+					pipeline.countLines=soak.currentIteration()==1;
+					if(shardCount>1){
+						pipeline.addShard(shardIndex,shardCount,1);
+					}
+					if(worker>=0){
+						pipeline.addShard(worker,workers,shardCount);
+					}
+					if(soak.regenerate&&soak.currentIteration()>1){
+						payloadCache=NULL;
+						pcreRound++;
+					}
+					pipeline.start(&ruleFile,host,parseThreads);
+					while(!soak.expired()&&pipeline.next(&requests)){
+						if(respondPort>=0){
+							responder.expect(&requests);
+						}
+						sendRequests(&requests);
+					}
+					pipeline.finish();
+					if(pipeline.failed){
+						exit(1);
+					}
+					payloadCache=cache;
+					if(soak.currentIteration()==1){
+						std::cout << pipeline.parsedRules << (soak.expired()?" rules parsed before the run ended":" rules successfully parsed");
+						if(pipeline.selectedRules!=pipeline.parsedRules){
+							std::cout << ", " << pipeline.selectedRules << " of them sent by this process";
+						}
+						std::cout << "\n";
+						if(verbose||customPcreRewrites){
+							pcreRewrites.report();
+						}
+					}
+					continue;
+				}
+				if(soak.regenerate&&soak.currentIteration()>1){
+					//cached payloads would be the same again, and new ones must not pile up in the cache over a long run
+					pcrePayloadCache* cache=payloadCache;
+					payloadCache=NULL;
+					pcreRound++;
+					if(payloadVariants>1){
+						//the number of requests per rule can change with new variants
+						pcreVariants.clear();
+						prepareRulePackets(&parsedRules,host,&requests);
+					}else{
+						for(unsigned long i=0;i<pcreRequests.size();i++){
+							prepareRulePacket(&parsedRules[pcreRequests[i]],host,&requests[pcreRequests[i]]);
+						}
+					}
+					payloadCache=cache;
+					//status codes from pcres change as well
+					if(respondPort>=0){
+						responder.expect(&requests);
+					}
+				}
+				sendRequests(&requests);
+			}
+			if(watchRules){
+				signal(SIGINT,requestStop);
+				signal(SIGTERM,requestStop);
+				std::cout << "Watching " << readFile << " for changes, stop with Ctrl-C\n";
+				while(watcher.wait()){
+					std::chrono::steady_clock::time_point changeStart=std::chrono::steady_clock::now();
+					if(!watcher.update()){
+						fprintf(stderr,"Unable to read rule file %s, waiting for the next change\n",readFile.c_str());
+						continue;
+					}
+					if(shardCount>1){
+						selectShard(&watcher.changedRules,shardIndex,shardCount,1);
+					}
+					if(printRules){
+						for(unsigned long i=0;i<watcher.changedRules.size();i++){
+							printSnortRule(&watcher.changedRules[i]);
+						}
+					}
+					//like rules with parse errors, rules that can not be sent are left out and the watch goes on
+					prepareRulePackets(&watcher.changedRules,host,&requests);
+					if(respondPort>=0){
+						responder.expect(&requests);
+					}
+					sendRequests(&requests);
+					fprintf(stdout,"Rule file changed: %lu lines added or edited, %lu removed, %lu requests sent in %.3f s\n",
+							watcher.addedLines,watcher.removedLines,(unsigned long)requests.size(),
+							std::chrono::duration<double>(std::chrono::steady_clock::now()-changeStart).count());
+				}
+			}
+			if(pcapExport){
+				pcap.close();
+				std::cout << "Wrote " << pcap.sessions << " TCP sessions (" << pcap.packets << " packets) to " << pcapFileName << "\n";
+			}else{
+				if(responseSink!=NULL){
+					capture.close();
+					responseSink=NULL;
+				}
+				soak.summary();
+				limiter.report();
+				if(respondPort>=0){
+					//every request got its response, so the responder has counted all of them
+					responder.stop();
+					responder.report(&statistics.sentPerSid);
+				}
+				if(statsJsonFileName!=""&&!statistics.writeJson(statsJsonFileName)){
+					fprintf(stderr,"Unable to write statistics file %s\n",statsJsonFileName.c_str());
+				}
+			}
+    	}
+    	curl_global_cleanup();
     }else{
     	std::cout << "Not sending out packets\n";
     }
 
+    if(worker>=0){
+    	//streaming workers all read the whole file, the coordinator parsed nothing
+    	if(streamRules&&worker==0){
+    		lineStatistics.report();
+    	}
+    	workerPool.finishWorker();
+    }
+
+    lineStatistics.report();
+
+    if(usePcreCache){
+    	pcreCache.save();
+    	std::cout << "PCRE payload cache: " << pcreCache.hits << " hits, " << pcreCache.misses << " misses\n";
+    }
+
     std::cout << "--------\n-ByeBye-\n--------\n";
     return 0;
 }
+#endif
@@ -0,0 +1,485 @@
+ /*
+ * Copyright (C) 2017 Felix Erlacher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ *
+ * Benchmark of the rule parser and the request builder of the idsEventGenerator.
+ * Generates a synthetic Snort rule set of configurable size and option mix, times every parser stage,
+ * request preparation and sending to a loopback sink and writes the results as JSON, so runs can be compared.
+ *
+ * REMARKS:
+ * -The generator is compiled in, so the benchmark always measures the code it was built with.
+ * -Sending is measured against the built-in responder in this process, so it measures the sender and not a webserver.
+ */
+
+#define IDSEVENTGENERATOR_NO_MAIN
+#include "idsEventGenerator.cpp"
+
+/**
+ * writes Snort rules of a configurable size and option mix, every rule is accepted by the parser
+ */
+class syntheticRuleSet {
+	public:
+		unsigned long rules=100000;
+		//share of rules with a pcre in addition to their contents
+		double pcreRatio=0.5;
+		//share of contents with hex bytes
+		double hexRatio=0.3;
+		//contents per rule, every rule has between 1 and this many
+		int contents=3;
+		//http modifiers contents and pcres are drawn from
+		std::vector<httpModifier> modifiers={HTTP_URI,HTTP_HEADER,HTTP_CLIENT_BODY,HTTP_COOKIE,HTTP_METHOD};
+		unsigned int seed=1;
+
+		/**
+		 * parses a comma separated list of http modifier names without http_, e.g. uri,header,cookie. Returns false for unknown ones
+		 */
+		bool setModifiers(std::string list){
+			std::size_t start=0;
+			std::size_t end;
+			std::string name;
+			modifiers.clear();
+			while(start<=list.size()){
+				end=list.find(',',start);
+				if(end==std::string::npos){
+					end=list.size();
+				}
+				name="http_"+list.substr(start,end-start);
+				int i;
+				for(i=HTTP_METHOD;i<HTTP_MODIFIERCOUNT;i++){
+					if(name==httpModifierNames[i]){
+						break;
+					}
+				}
+				//status modifiers are not sent by the client, rules with them would be rejected by the parser
+				if(i==HTTP_MODIFIERCOUNT||i==HTTP_STAT_CODE||i==HTTP_STAT_MSG){
+					return false;
+				}
+				modifiers.push_back((httpModifier)i);
+				start=end+1;
+			}
+			return !modifiers.empty();
+		}
+
+		/**
+		 * appends the rule set to text, one rule per line
+		 */
+		void generate(std::string* text){
+			std::mt19937 random(seed);
+			std::uniform_real_distribution<double> share(0,1);
+			std::uniform_int_distribution<int> contentCount(1,contents);
+			std::uniform_int_distribution<unsigned long> modifierIndex(0,modifiers.size()-1);
+			for(unsigned long i=0;i<rules;i++){
+				bool hasMethod=false;
+				text->append("alert tcp $EXTERNAL_NET any -> $HOME_NET $HTTP_PORTS (msg:\"BENCHMARK synthetic rule ");
+				text->append(std::to_string(i));
+				text->append("\"; flow:to_server,established; ");
+				int count=contentCount(random);
+				for(int j=0;j<count;j++){
+					httpModifier modifier=modifiers[modifierIndex(random)];
+					//a request has only one method
+					if(modifier==HTTP_METHOD&&hasMethod){
+						modifier=HTTP_URI;
+					}
+					appendContent(text,modifier,share(random)<hexRatio,i,j,&random);
+					if(modifier==HTTP_METHOD){
+						hasMethod=true;
+					}
+				}
+				if(share(random)<pcreRatio){
+					httpModifier modifier=modifiers[modifierIndex(random)];
+					if(modifier==HTTP_METHOD){
+						modifier=HTTP_URI;
+					}
+					appendPcre(text,modifier,&random);
+				}
+				text->append("classtype:web-application-attack; sid:");
+				text->append(std::to_string(1000000+i));
+				text->append("; rev:1;)\n");
+			}
+		}
+
+	private:
+		void appendContent(std::string* text, httpModifier modifier, bool hex, unsigned long rule, int index, std::mt19937* random){
+			static const char* methods[]={"GET","POST","PUT","DELETE","OPTIONS"};
+			text->append("content:\"");
+			switch(modifier){
+				case HTTP_METHOD:
+					text->append(methods[(*random)()%5]);
+					break;
+				case HTTP_URI:
+				case HTTP_RAW_URI:
+					text->append("/bench/"+std::to_string(rule)+"/"+std::to_string(index));
+					text->append(hex?"|2e 70 68 70|?id=":".php?id=");
+					break;
+				case HTTP_HEADER:
+				case HTTP_RAW_HEADER:
+					text->append("X-Bench-"+std::to_string(index));
+					text->append(hex?"|3a 20|":": ");
+					text->append(std::to_string(rule));
+					break;
+				default:
+					text->append("bench"+std::to_string(index)+"=");
+					text->append(hex?"|41 42 43 44|":"ABCD");
+					text->append(std::to_string(rule));
+					break;
+			}
+			text->append("\"; ");
+			text->append(httpModifierNames[modifier]);
+			if((*random)()%4==0){
+				text->append("; nocase");
+			}
+			text->append("; ");
+		}
+
+		void appendPcre(std::string* text, httpModifier modifier, std::mt19937* random){
+			static const char* patterns[]={"\\/[a-z]{3,8}\\.(php|asp|jsp)\\?[a-z]+=\\d{1,5}","^[A-Z][a-z0-9_-]{4,16}=[^&]{8,}","(select|union|insert)\\s+[a-z\\x2a]+\\s+from","[0-9a-f]{32}\\x3b\\s*(admin|root)"};
+			static const char modifierLetters[HTTP_MODIFIERCOUNT]={0,'M','U','I','Y','S','H','D','P','C','K'};
+			text->append("pcre:\"/");
+			text->append(patterns[(*random)()%4]);
+			text->append("/");
+			if((*random)()%2==0){
+				text->append("i");
+			}
+			text->push_back(modifierLetters[modifier]);
+			text->append("\"; ");
+		}
+};
+
+/**
+ * sends everything written to stdout to /dev/null while it exists, senders print a line for every request
+ */
+class quietStdout {
+	public:
+		quietStdout(){
+			fflush(stdout);
+			savedFd=dup(STDOUT_FILENO);
+			int nullFd=open("/dev/null",O_WRONLY);
+			if(nullFd>=0){
+				dup2(nullFd,STDOUT_FILENO);
+				close(nullFd);
+			}
+		}
+
+		~quietStdout(){
+			fflush(stdout);
+			if(savedFd>=0){
+				dup2(savedFd,STDOUT_FILENO);
+				close(savedFd);
+			}
+		}
+
+	private:
+		int savedFd;
+};
+
+/**
+ * throughput of one benchmarked stage
+ */
+class benchmarkResult {
+	public:
+		std::string name;
+		unsigned long items;
+		double seconds;
+};
+
+/**
+ * runs stage once and records how many items it handled per second
+ */
+template<typename stageFunction>
+void runStage(std::string name, unsigned long items, std::vector<benchmarkResult>* results, stageFunction stage){
+	std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+	stage();
+	benchmarkResult result;
+	result.name=name;
+	result.items=items;
+	result.seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+	results->push_back(result);
+	fprintf(stderr,"%-32s %10lu items %9.3f s %12.0f items/s\n",name.c_str(),items,result.seconds,result.seconds>0?items/result.seconds:0.0);
+}
+
+bool writeBenchmarkJson(std::string fileName, syntheticRuleSet* ruleSet, std::vector<benchmarkResult>* results){
+	FILE* out=fileName=="-"?stdout:fopen(fileName.c_str(),"w");
+	if(out==NULL){
+		return false;
+	}
+	fprintf(out,"{\n\"rules\": %lu,\n\"pcre_ratio\": %.3f,\n\"hex_ratio\": %.3f,\n\"contents_per_rule\": %d,\n\"modifiers\": [",
+			ruleSet->rules,ruleSet->pcreRatio,ruleSet->hexRatio,ruleSet->contents);
+	for(unsigned long i=0;i<ruleSet->modifiers.size();i++){
+		fprintf(out,"%s\"%s\"",i==0?"":", ",httpModifierNames[ruleSet->modifiers[i]]);
+	}
+	fprintf(out,"],\n\"seed\": %u,\n\"results\": [",ruleSet->seed);
+	for(unsigned long i=0;i<results->size();i++){
+		benchmarkResult* result=&results->at(i);
+		fprintf(out,"%s\n\t{\"name\": \"%s\", \"items\": %lu, \"seconds\": %.6f, \"items_per_second\": %.1f}",i==0?"":",",
+				result->name.c_str(),result->items,result->seconds,result->seconds>0?result->items/result->seconds:0.0);
+	}
+	fprintf(out,"\n]\n}\n");
+	if(out!=stdout){
+		fclose(out);
+	}
+	return true;
+}
+
+void benchmarkUsage(std::string progName){
+	std::cerr << "Usage: " << progName << " [option]\n"
+			<< "Benchmarks the rule parser, request preparation and sending on a synthetic rule set\n"
+			<< "Options:\n"
+			<< "\t-h,--help\t\tShow this help message\n"
+			<< "\t--rules\t\t\tNumber of generated rules (default 100000)\n"
+			<< "\t--pcre-ratio\t\tShare of rules with a pcre (default 0.5)\n"
+			<< "\t--hex-ratio\t\tShare of contents with hex bytes (default 0.3)\n"
+			<< "\t--contents\t\tMaximum number of contents per rule (default 3)\n"
+			<< "\t--modifiers\t\tComma separated http modifiers of contents and pcres (default uri,header,client_body,cookie,method)\n"
+			<< "\t--seed\t\t\tSeed of the rule generator and the PCRE string generator (default 1)\n"
+			<< "\t-t,--threads\t\tNumber of threads of the parallel ingest stage (default number of cores)\n"
+			<< "\t--send\t\t\tNumber of requests sent to the loopback sink per backend, 0 skips sending (default 20000)\n"
+			<< "\t-n,--concurrency\tRequests in flight while sending (default 16)\n"
+			<< "\t--write-rules\t\tAlso write the generated rule set to this file, e.g. as input for the idsEventGenerator\n"
+			<< "\t-o,--output\t\tWrite the JSON results to this file, - for stdout (default)\n"
+			<< std::endl;
+}
+
+enum benchmarkOption {BENCHMARK_RULES=1000, BENCHMARK_PCRERATIO, BENCHMARK_HEXRATIO, BENCHMARK_CONTENTS, BENCHMARK_MODIFIERS, BENCHMARK_SEED,
+	BENCHMARK_SEND, BENCHMARK_WRITERULES};
+
+int main (int argc, char* argv[]) {
+	syntheticRuleSet ruleSet;
+	std::string outputFileName="-";
+	std::string rulesFileName;
+	unsigned long sendCount=20000;
+	int concurrency=16;
+	int parseThreads=std::max(1U,std::thread::hardware_concurrency());
+	int index=0,iarg=0;
+	std::vector<benchmarkResult> results;
+
+	while(1){
+		const struct option longOptions[]={
+				{"help",        no_argument,       0, 'h'},
+				{"rules",       required_argument, 0, BENCHMARK_RULES},
+				{"pcre-ratio",  required_argument, 0, BENCHMARK_PCRERATIO},
+				{"hex-ratio",   required_argument, 0, BENCHMARK_HEXRATIO},
+				{"contents",    required_argument, 0, BENCHMARK_CONTENTS},
+				{"modifiers",   required_argument, 0, BENCHMARK_MODIFIERS},
+				{"seed",        required_argument, 0, BENCHMARK_SEED},
+				{"threads",     required_argument, 0, 't'},
+				{"send",        required_argument, 0, BENCHMARK_SEND},
+				{"concurrency", required_argument, 0, 'n'},
+				{"write-rules", required_argument, 0, BENCHMARK_WRITERULES},
+				{"output",      required_argument, 0, 'o'},
+				{0,             0,                 0,  0},
+		};
+		iarg=getopt_long_only(argc,argv,"ht:n:o:",longOptions,&index);
+		if(iarg==-1){
+			break;
+		}
+		switch(iarg){
+			case BENCHMARK_RULES:
+				ruleSet.rules=strtoul(optarg,NULL,10);
+				break;
+			case BENCHMARK_PCRERATIO:
+				ruleSet.pcreRatio=atof(optarg);
+				break;
+			case BENCHMARK_HEXRATIO:
+				ruleSet.hexRatio=atof(optarg);
+				break;
+			case BENCHMARK_CONTENTS:
+				ruleSet.contents=atoi(optarg);
+				if(ruleSet.contents<1){
+					fprintf(stderr,"Every rule needs at least one content\n");
+					exit(1);
+				}
+				break;
+			case BENCHMARK_MODIFIERS:
+				if(!ruleSet.setModifiers(optarg)){
+					fprintf(stderr,"Unknown or unsupported http modifier in: %s\n",optarg);
+					benchmarkUsage(argv[0]);
+					exit(1);
+				}
+				break;
+			case BENCHMARK_SEED:
+				ruleSet.seed=strtoul(optarg,NULL,10);
+				break;
+			case BENCHMARK_SEND:
+				sendCount=strtoul(optarg,NULL,10);
+				break;
+			case BENCHMARK_WRITERULES:
+				rulesFileName=optarg;
+				break;
+			case 't':
+				parseThreads=atoi(optarg);
+				if(parseThreads<1){
+					fprintf(stderr,"Number of parser threads must be at least 1\n");
+					exit(1);
+				}
+				break;
+			case 'n':
+				concurrency=atoi(optarg);
+				if(concurrency<1){
+					fprintf(stderr,"Concurrency must be at least 1\n");
+					exit(1);
+				}
+				break;
+			case 'o':
+				outputFileName=optarg;
+				break;
+			default:
+				benchmarkUsage(argv[0]);
+				exit(1);
+		}
+	}
+	pcreSeed=ruleSet.seed;
+
+	std::string text;
+	ruleSet.generate(&text);
+	if(rulesFileName!=""){
+		std::ofstream rulesFile(rulesFileName);
+		rulesFile << text;
+		if(!rulesFile){
+			fprintf(stderr,"Unable to write rule file %s\n",rulesFileName.c_str());
+			exit(1);
+		}
+	}
+	std::vector<std::string_view> lines;
+	std::string_view contents=text;
+	for(std::size_t position=0,end;position<contents.size();position=end+1){
+		end=contents.find('\n',position);
+		if(end==std::string_view::npos){
+			end=contents.size();
+		}
+		lines.push_back(contents.substr(position,end-position));
+	}
+	fprintf(stderr,"Generated %lu rules (%lu bytes)\n",(unsigned long)lines.size(),(unsigned long)text.size());
+
+	//the keyword pre-filter of parseRuleLine, one pass per line
+	std::vector<ruleKeywordMatches> keywords(lines.size());
+	runStage("scanRuleKeywords",lines.size(),&results,[&](){
+		for(unsigned long i=0;i<lines.size();i++){
+			ruleKeywords.scan(lines[i],&keywords[i]);
+		}
+	});
+	//the stages work on the options of every line, like parseRuleLine does
+	std::vector<std::vector<ruleOption> > options(lines.size());
+	runStage("tokenizeRuleBody",lines.size(),&results,[&](){
+		for(unsigned long i=0;i<lines.size();i++){
+			tokenizeRuleBody(lines[i],&options[i]);
+		}
+	});
+	std::vector<snortRule> rules(lines.size());
+	runStage("parseContent",lines.size(),&results,[&](){
+		for(unsigned long i=0;i<lines.size();i++){
+			ruleParseContext context;
+			parseContent(&options[i],&context,&rules[i]);
+		}
+	});
+	runStage("parseContentModifier",lines.size(),&results,[&](){
+		for(unsigned long i=0;i<lines.size();i++){
+			ruleParseContext context;
+			parseContentModifier(&options[i],&context,&rules[i]);
+		}
+	});
+	std::vector<unsigned long> pcreLines;
+	for(unsigned long i=0;i<lines.size();i++){
+		if(findRuleOption(&options[i],"pcre")!=NULL){
+			pcreLines.push_back(i);
+		}
+	}
+	runStage("parsePcre",pcreLines.size(),&results,[&](){
+		for(unsigned long i=0;i<pcreLines.size();i++){
+			ruleParseContext context;
+			parsePcre(&options[pcreLines[i]],&context,&rules[pcreLines[i]]);
+		}
+	});
+	std::vector<std::string> pcres;
+	for(unsigned long i=0;i<pcreLines.size();i++){
+		pcres.push_back(rules[pcreLines[i]].body.matches.back().pattern);
+	}
+	runStage("sanitizePCRE",pcres.size(),&results,[&](){
+		for(unsigned long i=0;i<pcres.size();i++){
+			sanitizePCRE(pcres[i],"0");
+		}
+	});
+
+	std::vector<parsedLine> parsed;
+	std::vector<snortRule> parsedRules;
+	auto ingest=[&](int threads){
+		parsedRules.clear();
+		for(unsigned long start=0;start<lines.size();start+=PARSEBATCHSIZE){
+			std::vector<std::string_view> batch(lines.begin()+start,lines.begin()+std::min(start+PARSEBATCHSIZE,(unsigned long)lines.size()));
+			parseRuleLines(&batch,start+1,&parsed,threads);
+			for(unsigned long i=0;i<parsed.size();i++){
+				if(parsed[i].context.fatal){
+					fprintf(stderr,"Generated rule in line %lu was rejected\n",start+i+1);
+					exit(1);
+				}
+				if(parsed[i].pushRule){
+					parsedRules.push_back(std::move(parsed[i].rule));
+				}
+			}
+		}
+	};
+	runStage("ingest",lines.size(),&results,[&](){ingest(1);});
+	if(parseThreads>1){
+		runStage("ingest_"+std::to_string(parseThreads)+"_threads",lines.size(),&results,[&](){ingest(parseThreads);});
+	}
+
+	curl_global_init(CURL_GLOBAL_ALL);
+	{
+		ruleResponder sink;
+		if(!sink.start(0)){
+			fprintf(stderr,"Could not start loopback sink: %s\n",strerror(errno));
+			exit(1);
+		}
+		std::string host="http://127.0.0.1:"+std::to_string(sink.port());
+		std::vector<preparedRequest> requests;
+		runStage("prepareRulePackets",parsedRules.size(),&results,[&](){
+			prepareRulePackets(&parsedRules,host,&requests);
+		});
+		if(sendCount>0&&!requests.empty()){
+			std::vector<preparedRequest> sendRequests;
+			//the raw backend sends the serialized request, prepare again so both backends get the same requests
+			rawBackend=true;
+			for(unsigned long i=0;i<sendCount;i++){
+				sendRequests.emplace_back();
+				prepareRulePacket(&parsedRules[i%parsedRules.size()],host,&sendRequests.back());
+			}
+			rawBackend=false;
+			sink.expect(&sendRequests);
+			curlHandlePool pool;
+			sendRateLimiter limiter;
+			soakRun soak;
+			runStage("send_curl",sendCount,&results,[&](){
+				quietStdout quiet;
+				sendRulePacketsConcurrent(&sendRequests,false,concurrency,&pool,&limiter,&soak);
+			});
+			rawHttpSender rawSender(false);
+			runStage("send_raw",sendCount,&results,[&](){
+				quietStdout quiet;
+				rawSender.send(&sendRequests,concurrency,&limiter,&soak);
+			});
+			if(failedRequests>0){
+				fprintf(stderr,"%lu of %lu requests to the loopback sink failed\n",failedRequests,finishedRequests);
+			}
+		}
+	}
+	curl_global_cleanup();
+
+	if(!writeBenchmarkJson(outputFileName,&ruleSet,&results)){
+		fprintf(stderr,"Unable to write benchmark results to %s\n",outputFileName.c_str());
+		exit(1);
+	}
+	return 0;
+}